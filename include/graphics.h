@@ -4,36 +4,42 @@
 #include "sdl_trigger.h"
 
 struct Button {
-    std::vector<SDL_Keycode> keys;
+    const Trigger::Group* group;
+    Trigger::Handle handle; // of the combination the key belongs to
     size_t index;
+    SDL_Keycode key; // on its label, it changes if the combination is rebound
     bool isEnabled;
+    bool isDown;
+    bool isDirty; // the retained surface does not show the current state
 
-    Trigger::KeyState* keyState = NULL;
     SDL_Surface* surface = NULL;
 
     const int BUTTON_PADDING = 7;
     const int BUTTON_HEIGHT = 7;
     const int BUTTON_DEPTH = 4;
 
-    Button(std::vector<SDL_Keycode> keys, size_t index);
+    Button(const Trigger::Group& group, Trigger::Handle handle, size_t index);
 
-    static Button forCombinationKey(std::vector<SDL_Keycode> keys, size_t index);
+    void findKeyState(); // marks it dirty when the state changed
 
-    void findKeyState();
-
-    SDL_Surface* render();
+    SDL_Surface* render(); // redraws only when dirty
+    void free();
 };
 
 struct Combination {
     std::string description;
+    const Trigger::Group* group;
+    Trigger::Handle handle;
     std::vector<Button> buttons;
     SDL_Surface *surface;
+    Uint32 checkedChanges; // Trigger::changeCount() when the buttons were last checked
 
     const int DESCRIPTION_WIDTH = 150;
     const int BUTTON_DISTANCE = 7;
 
-    Combination(std::string description, std::vector<SDL_Keycode> keys);
-    SDL_Surface* render();
+    Combination(std::string description, const Trigger::Group& group, Trigger::Handle handle);
+    SDL_Surface* render(); // the retained surface, redrawn only when a button changed
+    void createButtons();  // one for every key the combination is bound to now
 };
 
 extern std::vector<Combination> combinations;
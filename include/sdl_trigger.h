@@ -2,58 +2,745 @@
 #define SDL_TRIGGER_H
 
 #include "SDL2/SDL.h"
-#include <functional>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+// bytes available for the captures of a callback, bigger callables are rejected at compile time
+#ifndef SDL_TRIGGER_CALLBACK_SIZE
+#define SDL_TRIGGER_CALLBACK_SIZE (4 * sizeof(void*))
+#endif
+
 namespace Trigger {
-    using Callback = std::function<void(void)>;
     using Keycodes = std::vector<SDL_Keycode>;
 
-    struct KeyState {
-        SDL_Keycode key;
-        bool isDown;
+    // move-only void(void) callable stored inline, registering one never allocates
+    class Callback {
+    public:
+        static const size_t CAPACITY = SDL_TRIGGER_CALLBACK_SIZE;
+
+        Callback() : operations{nullptr} {
+            //
+        }
+
+        template <typename Function, typename Stored = typename std::decay<Function>::type,
+                  typename = typename std::enable_if<!std::is_same<Stored, Callback>::value>::type>
+        Callback(Function&& function) : operations{&Operations::template of<Stored>()} {
+            static_assert(sizeof(Stored) <= CAPACITY, "Callback captures too much, raise SDL_TRIGGER_CALLBACK_SIZE!");
+            static_assert(alignof(Stored) <= alignof(std::max_align_t), "Callback is over-aligned!");
+            new (storage) Stored(std::forward<Function>(function));
+        }
+
+        Callback(Callback&& other) noexcept : operations{other.operations} {
+            moveFrom(other);
+        }
+
+        Callback& operator=(Callback&& other) noexcept {
+            if (this != &other) {
+                destroy();
+                operations = other.operations;
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        Callback(const Callback&) = delete;
+        Callback& operator=(const Callback&) = delete;
+
+        ~Callback() {
+            destroy();
+        }
+
+        void operator()() {
+            operations->invoke(storage);
+        }
+
+        explicit operator bool() const {
+            return operations != nullptr;
+        }
+
+        // direct calls of a function known at compile time, nothing is stored
+        template <void (*Function)()>
+        static Callback of() {
+            Callback callback;
+            callback.operations = &Operations::template ofFunction<Function>();
+            return callback;
+        }
+
+        // direct calls of a method known at compile time, only the object pointer is stored
+        template <typename T, void (T::*Method)()>
+        static Callback of(T& object) {
+            Callback callback;
+            callback.operations = &Operations::template ofMethod<T, Method>();
+            new (callback.storage) T*(&object);
+            return callback;
+        }
+
+    private:
+        struct Operations {
+            void (*invoke)(void* storage);
+            void (*move)(void* to, void* from); // NULL if memcpy is enough
+            void (*destroy)(void* storage);     // NULL if trivially destructible
+
+            template <typename Stored>
+            static void invokeStored(void* storage) {
+                (*static_cast<Stored*>(storage))();
+            }
+
+            template <typename Stored>
+            static void moveStored(void* to, void* from) {
+                new (to) Stored(std::move(*static_cast<Stored*>(from)));
+                static_cast<Stored*>(from)->~Stored();
+            }
+
+            template <typename Stored>
+            static void destroyStored(void* storage) {
+                static_cast<Stored*>(storage)->~Stored();
+            }
+
+            template <void (*Function)()>
+            static void invokeFunction(void*) {
+                Function();
+            }
+
+            template <typename T, void (T::*Method)()>
+            static void invokeMethod(void* storage) {
+                ((*static_cast<T**>(storage))->*Method)();
+            }
+
+            template <typename Stored>
+            static const Operations& of() {
+                static const Operations operations = {
+                    &invokeStored<Stored>,
+                    std::is_trivially_copyable<Stored>::value ? nullptr : &moveStored<Stored>,
+                    std::is_trivially_destructible<Stored>::value ? nullptr : &destroyStored<Stored>
+                };
+                return operations;
+            }
+
+            template <void (*Function)()>
+            static const Operations& ofFunction() {
+                static const Operations operations = {&invokeFunction<Function>, nullptr, nullptr};
+                return operations;
+            }
+
+            template <typename T, void (T::*Method)()>
+            static const Operations& ofMethod() {
+                static const Operations operations = {&invokeMethod<T, Method>, nullptr, nullptr};
+                return operations;
+            }
+        };
+
+        void moveFrom(Callback& other) {
+            if (operations != nullptr) {
+                if (operations->move != nullptr) {
+                    operations->move(storage, other.storage);
+                } else {
+                    std::memcpy(storage, other.storage, CAPACITY);
+                }
+                other.operations = nullptr;
+            }
+        }
+
+        void destroy() {
+            if (operations != nullptr && operations->destroy != nullptr) {
+                operations->destroy(storage);
+            }
+            operations = nullptr;
+        }
+
+        alignas(std::max_align_t) unsigned char storage[CAPACITY];
+        const Operations* operations;
+    };
+
+#ifdef SDL_TRIGGER_STATS
+    // relaxed counter, readable from any thread while the input is processed
+    struct StatsCounter {
+        std::atomic<Uint64> value;
+
+        StatsCounter() : value{0} {
+            //
+        }
+
+        StatsCounter(const StatsCounter& other) : value{other.load()} {
+            //
+        }
+
+        void add(Uint64 amount) {
+            value.fetch_add(amount, std::memory_order_relaxed);
+        }
+
+        void raiseTo(Uint64 amount) {
+            Uint64 current = load();
+            while (current < amount && !value.compare_exchange_weak(current, amount, std::memory_order_relaxed)) {
+                //
+            }
+        }
+
+        Uint64 load() const {
+            return value.load(std::memory_order_relaxed);
+        }
+
+        void reset() {
+            value.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    struct TriggerStats {
+        StatsCounter evaluations;    // keypresses of one of its keys
+        StatsCounter partialMatches; // evaluations that did not fulfil it
+        StatsCounter resets;         // pressed keys forgotten because of another key
+        StatsCounter fires;
+        StatsCounter callbackTicks;  // SDL_GetPerformanceCounter ticks spent in the callback
+        StatsCounter maxCallbackTicks;
+
+        void reset(); // for the next binding of an unbound trigger
+    };
+
+    struct GroupStats {
+        StatsCounter keypresses;
+        StatsCounter fires;
     };
+#endif
+
+    // which keys are held down, shared by every group and updated once per
+    // event by Trigger::processEvent, before the groups see the event
+    struct KeyboardState {
+        static const size_t MAX_HELD_KEYS = 32; // further keys held at the same time are not tracked
 
+        Uint32 presses; // non-repeated keypresses so far, each group sees them in this order
+        Uint8 scancodes[SDL_NUM_SCANCODES];
+        SDL_Keycode heldKeys[MAX_HELD_KEYS];
+        SDL_Scancode heldScancodes[MAX_HELD_KEYS]; // of the held keys, in the same order
+        size_t heldCount;
+
+        KeyboardState();
+
+        void processEvent(const SDL_Event& e);
+        void reset();
+
+        bool isKeyDown(SDL_Keycode key) const;
+        bool isScancodeDown(SDL_Scancode scancode) const;
+    };
+    extern KeyboardState& keyboard; // of the default context
+
+    // the keys of a combination live in its group's contiguous key storage,
+    // the combination only tracks which of its slots were pressed since its
+    // last reset, released keys are filtered through the keyboard state
     struct KeyCombination {
-        std::vector<KeyState> keys;
+        static const size_t MAX_KEYS = 32;
+
+        Uint32 firstKey;
+        Uint32 keyCount;
+        Uint32 downMask;
+        Uint32 fulfilledMask;
 
-        bool hasKey(SDL_Keycode key) const;
-        void markKeyDown(SDL_Keycode key);
-        void markKeyUp(SDL_Keycode key);
+        KeyCombination(size_t firstKey, size_t keyCount);
+
+        void markKeysDown(Uint32 slots);
+        void markKeysUp(Uint32 slots);
         void reset();
         bool isFulfilled() const;
+        bool isKeyDown(size_t slot) const;
+    };
+
+    // hashes a key list, eg. the sorted keys of a chord
+    struct KeycodesHash {
+        size_t operator()(const Keycodes& keys) const;
     };
 
     struct Trigger {
+        enum Kind {
+            PRESS,    // its combination is fulfilled by a keypress
+            SEQUENCE, // its chords were pressed one after the other
+            HOLD,     // its combination is held for interval milliseconds
+            REPEAT,   // fulfilled, then every interval milliseconds while held
+            RELEASE,  // a key of its fulfilled combination is released
+            MODIFIED  // its single key is pressed with exactly its modifiers held
+        };
+
         KeyCombination combination;
-        Callback callback;
+        Kind kind;
+        Uint32 lastPress; // keyboard.presses when one of its keys was last pressed, 0 after a reset
+        Uint32 epoch;     // of its group when it was last touched, its state is reset if stale
+        Uint32 interval;  // of HOLD and REPEAT triggers
+        Uint32 sequenceEnd; // trie node of SEQUENCE triggers, where they fire
+        Uint32 timerGeneration; // timers scheduled before the last fulfilment are stale
+        Uint16 modifiers;         // SDL_Keymod bits of MODIFIED triggers
+        Uint16 anySideModifiers;  // both bits of the modifiers where either side will do
+        Uint32 generation;        // of the handles to it, bumped when it is unbound
+        Uint32 keyCapacity;       // key slots it owns in its group, reused when it is rebound
+        bool isFree;              // unbound, its slot is taken by a later binding
+#ifdef SDL_TRIGGER_STATS
+        TriggerStats stats;
+#endif
+
+        Trigger(KeyCombination combination, Kind kind = PRESS, Uint32 interval = 0);
+
+        bool matchesModifiers(Uint16 mod) const; // the keysym.mod of a keypress
+    };
+
+    // a binding of a group, unlike an index or a pointer into the group it
+    // can not end up at another binding, it is only valid or not
+    struct Handle {
+        Uint32 index;
+        Uint32 generation; // never 0, so a zeroed handle is invalid
+
+        bool isValid() const {
+            return generation != 0;
+        }
+    };
+
+    struct Group;
+    struct Context;
+
+    // hierarchical timer wheel with millisecond resolution, scheduling and
+    // expiring a timer is O(1), advancing steps through the slots of the
+    // lowest used level only, and every timer moves down at most LEVELS
+    // times, so pending timers are never polled one by one
+    struct TimerWheel {
+        static const size_t LEVELS = 4;
+        static const size_t SLOT_BITS = 6;
+        static const size_t SLOTS = 1 << SLOT_BITS; // the levels span 2^24 ms, about 4.6 hours
+
+        struct Timer {
+            Group* group; // NULL if the group got destroyed while expiring
+            size_t trigger;
+            Uint32 generation;
+            Uint32 deadline;
+        };
+
+        std::vector<Timer> slots[LEVELS][SLOTS];
+        std::vector<Timer> due;       // of the millisecond being expired
+        std::vector<Timer> cascading; // of the slot being moved a level down
+        size_t levelCounts[LEVELS];   // empty levels are skipped over
+        Uint32 now;
+        size_t count;
+        bool isStarted;
+        bool isAdvancing;
 
-        Trigger(Keycodes keys, Callback callback);
+        TimerWheel();
+
+        void schedule(const Timer& timer);
+        void place(const Timer& timer);
+        void advance(Uint32 to); // expires the due timers in deadline order
+        void cancel(const Group* group);
+        void reset(); // forgets every timer, the next advance starts the clock
+        size_t size() const;
     };
+    extern TimerWheel& timers; // of the default context
 
     struct Group {
+        // slots of a trigger holding the same key
+        struct KeySlots {
+            size_t trigger;
+            Uint32 slots;
+        };
+
+        // the triggers holding a key, appended when they are bound and
+        // swapped out when they are unbound, both O(1), so the first key
+        // event finding them out of trigger order sorts them again
+        struct KeyEntries {
+            std::vector<KeySlots> entries;
+            bool isUnsorted;
+        };
+
+        // the keys of a bound trigger, where they are in keys, or the keys
+        // to look up, so bindings are found by their keys without copying them
+        struct KeySpan {
+            mutable size_t trigger; // may become another one with the same keys
+            const SDL_Keycode* codes; // NULL for the keys of the trigger
+            size_t count;
+        };
+        struct KeySpanHash {
+            const Group* group;
+            size_t operator()(const KeySpan& span) const;
+        };
+        struct KeySpanEqual {
+            const Group* group;
+            bool operator()(const KeySpan& a, const KeySpan& b) const;
+        };
+
+        // what the keys of the group are, SDL_Keycodes given to a scancode
+        // group are translated with the keyboard layout at registration,
+        // and the other way around, then it matches the physical keys only
+        enum Matching {
+            BY_KEYCODE,
+            BY_SCANCODE
+        };
+
+        // how a keypress finds the triggers holding its key, INDEXED looks
+        // them up in the dispatch index, PACKED compares the key to the
+        // packed keys of every trigger, with SSE2 or AVX2 many triggers per
+        // instruction if the CPU has them, and PACKED_SCALAR one by one
+        enum Evaluation {
+            INDEXED,
+            PACKED,
+            PACKED_SCALAR
+        };
+        static const size_t PACKED_LANES = 8; // of the widest instructions
+
+        Context& context; // it is matched in, it has to outlive the group
+        const Matching matching;
         std::vector<Trigger> triggers;
-        bool isEnabled;
+        std::vector<SDL_Keycode> keys; // key slots of every combination, contiguously, keycodes or scancodes
+        std::deque<Callback> callbacks; // of the triggers, never moved, so a callback can bind keys while it runs
+
+        // enable, disable and reset are safe from any thread and O(1), a
+        // reset only bumps the epoch and the triggers with an older one are
+        // reset when they are touched next
+        std::atomic<bool> isEnabled;
+        std::atomic<Uint32> epoch;
+
+        // groups see the events from the highest priority down, and a
+        // consuming group hides the keys it fires on from the lower ones
+        int priority;
+        std::atomic<bool> isConsuming;
+        bool hasFulfilled; // while processing the current event
 
-        Group();
-        ~Group();
+        // dispatch index: every key maps to the triggers containing it, by index,
+        // scancodes are dense, so a scancode group indexes them in a flat array instead
+        std::unordered_map<SDL_Keycode, KeyEntries> keyIndex;
+        std::vector<KeyEntries> scancodeIndex;
+        std::vector<Uint32> entryPositions; // like keys, where the entry of the trigger is in the list of the key
+        std::unordered_set<KeySpan, KeySpanHash, KeySpanEqual> triggersByKeys; // the lowest bound slot of exactly these keys, in order
+        std::vector<size_t> keylessTriggers; // empty combinations, fulfilled on every keypress
+        std::vector<size_t> freeTriggers;    // slots of unbound triggers, the last one is reused first
+        std::vector<size_t> unboundTriggers; // unbound while callbacks run, freed when they return
+        Uint32 firingDepth; // callbacks of the group being called
+        Uint32 matchingDepth; // keypresses, releases and sequence steps being matched, a callback may process events again
+        std::vector<std::unique_ptr<std::vector<size_t>>> candidates; // one list per matchingDepth, boxed so they never move
+        bool hasReleaseTriggers; // only then are key releases processed
+
+        // packed keys: slot s of trigger t is at packedCodes[s * packedStride + t],
+        // the slots past packedCounts[t] (every slot of an unbound trigger)
+        // are masked out, the dispatch index is kept up to date as well
+        Evaluation evaluation;
+        std::vector<SDL_Keycode> packedCodes;
+        std::vector<Sint32> packedCounts;
+        size_t packedWidth;  // columns, the most keys of a bound trigger
+        size_t packedStride; // lanes of a column, a multiple of PACKED_LANES
+        std::vector<KeySlots> packedHits; // of the current keypress, by trigger
+
+        // sequences are matched by a trie over the distinct chords of the
+        // group, a chord step is taken when exactly its keys are held
+        struct SequenceNode {
+            std::vector<Uint32> chords;   // of the outgoing edges
+            std::vector<size_t> triggers; // sequences ending here
+            Uint32 parent; // and the chord of the edge from it, to prune
+            Uint32 chord;  // the node once no sequence needs it
+        };
+        static const Uint32 DEFAULT_SEQUENCE_TIMEOUT = 1000;
+
+        std::vector<KeyCombination> chords;
+        std::unordered_map<Keycodes, Uint32, KeycodesHash> chordIds; // by sorted keys
+        std::vector<SequenceNode> sequenceNodes; // the root is the first one, added with the first sequence
+        std::vector<Uint32> freeSequenceNodes;   // pruned ones, reused first
+        std::unordered_map<Uint64, Uint32> sequenceEdges; // node << 32 | chord to the next node
+        Uint32 sequenceNode;
+        Uint32 sequenceEpoch;
+        Uint32 sequenceStepTime;
+        Uint32 sequenceTimeout; // milliseconds allowed between two steps
+        Keycodes heldChord;
+#ifdef SDL_TRIGGER_STATS
+        GroupStats stats;
+#endif
+
+        explicit Group(Matching matching = BY_KEYCODE); // in the default context
+        explicit Group(Context& context, Matching matching = BY_KEYCODE);
+        virtual ~Group();
+
+        Group(const Group&) = delete;
+        Group& operator=(const Group&) = delete;
 
         void enable();
         void disable();
         void toggle();
 
-        void on(SDL_Keycode key, Callback callback);
-        void on(Keycodes keys, Callback callback);
+        // groups of the same priority keep the order they got it in
+        void setPriority(int priority);
+        void setConsuming(bool isConsuming);
+
+        // both evaluations call the same callbacks in the same order, set it
+        // before processing events, switching to a packed one packs every binding
+        void setEvaluation(Evaluation evaluation);
+
+        Handle on(SDL_Keycode key, Callback callback);
+        Handle on(std::initializer_list<SDL_Keycode> keys, Callback callback);
+        Handle on(const Keycodes& keys, Callback callback);
+        Handle on(const SDL_Keycode* keys, size_t count, Callback callback);
+
+        Handle onScancode(SDL_Scancode scancode, Callback callback);
+        Handle onScancode(std::initializer_list<SDL_Scancode> scancodes, Callback callback);
+        Handle onScancode(const SDL_Scancode* scancodes, size_t count, Callback callback);
+
+        // the modifiers are compared to the keysym.mod of the keypress, eg.
+        // onModified(KMOD_CTRL | KMOD_SHIFT, SDLK_r, callback) takes either
+        // Control and either Shift, KMOD_LCTRL only the left Control
+        Handle onModified(Uint16 modifiers, SDL_Keycode key, Callback callback);
+
+        template <void (*Function)()>
+        Handle on(std::initializer_list<SDL_Keycode> keys) {
+            return on(keys, Callback::of<Function>());
+        }
+
+        template <typename T, void (T::*Method)()>
+        Handle on(std::initializer_list<SDL_Keycode> keys, T& object) {
+            return on(keys, Callback::of<T, Method>(object));
+        }
+
+        // eg. onSequence({{SDLK_LCTRL, SDLK_k}, {SDLK_LCTRL, SDLK_c}}, callback)
+        Handle onSequence(std::initializer_list<std::initializer_list<SDL_Keycode>> steps, Callback callback);
+        Handle onSequence(const std::vector<Keycodes>& steps, Callback callback);
+        void setSequenceTimeout(Uint32 milliseconds);
+
+        // timed triggers follow the timestamps of the events and Trigger::tick
+        Handle onHold(std::initializer_list<SDL_Keycode> keys, Uint32 milliseconds, Callback callback);
+        Handle onHold(const Keycodes& keys, Uint32 milliseconds, Callback callback);
+        Handle onRepeat(std::initializer_list<SDL_Keycode> keys, Uint32 interval, Callback callback);
+        Handle onRepeat(const Keycodes& keys, Uint32 interval, Callback callback);
+        Handle onRelease(std::initializer_list<SDL_Keycode> keys, Callback callback);
+        Handle onRelease(const Keycodes& keys, Callback callback);
+
+        // unbinding and rebinding are safe from callbacks and take O(1) per
+        // key, the next event of a changed key sorts its bindings again, an
+        // unbound handle is invalid forever and a later binding may take the
+        // place of the unbound one
+        bool off(Handle handle); // whether it was bound
+
+        // new keys for a binding, it keeps its callback, its kind and its handle,
+        // keys its kind does not take throw like at registration (eg. more
+        // than one for a modified key), then it keeps the old ones
+        void rebind(Handle handle, std::initializer_list<SDL_Keycode> keys);
+        void rebind(Handle handle, const Keycodes& keys);
+        void rebind(Handle handle, const SDL_Keycode* keys, size_t count);
+
+        // preallocates storage, so registering that many bindings never reallocates
+        void reserve(size_t triggerCount, size_t keyCount);
+
+        // the bound combination of exactly these keys in this order in the
+        // lowest slot, with any trigger kind but sequences, or an invalid
+        // handle, in O(1)
+        Handle find(std::initializer_list<SDL_Keycode> keys) const;
+        Handle find(const Keycodes& keys) const;
+        Handle find(const SDL_Keycode* keys, size_t count) const;
+
+        // the live state of a binding, an invalid handle has no keys
+        bool isBound(Handle handle) const;
+        size_t keyCount(Handle handle) const;
+        SDL_Keycode keyOf(Handle handle, size_t slot) const;
+        bool isKeyDown(Handle handle, size_t slot) const;
+
+        SDL_Keycode keyOf(const Trigger& trigger, size_t slot) const; // with the current layout in a scancode group
+        SDL_Keycode codeOf(SDL_Keycode key) const; // as stored in keys
+        SDL_Keycode codeOf(const SDL_Keysym& keysym) const;
+        bool isCodeDown(SDL_Keycode code) const;
+        KeyEntries* findKeyEntries(SDL_Keycode code); // in any order, NULL if no trigger holds it
+        const std::vector<KeySlots>* findKeySlots(SDL_Keycode code); // sorted by trigger
+        bool isKeyDown(const Trigger& trigger, size_t slot) const;
+        bool isFulfilled(const Trigger& trigger) const;
+        void reset();
+        void fulfil(size_t index); // fires or queues it in deferred mode
+        void fulfil(size_t index, Uint32 generation); // of a binding kept outside of triggers
+        virtual bool isCurrent(size_t index, Uint32 generation) const; // whether its queued callback may still be called
+        virtual void fire(size_t index);
+        Handle add(const SDL_Keycode* keys, size_t count, Callback callback, Trigger::Kind kind, Uint32 interval);
+        Handle addCodes(const SDL_Keycode* codes, size_t count, Callback callback, Trigger::Kind kind, Uint32 interval);
+        void translate(const SDL_Keycode* keys, size_t count, SDL_Keycode* codes) const; // into at most MAX_KEYS codes
+        void validate(const SDL_Keycode* codes, size_t count, Trigger::Kind kind, Uint32 interval) const;
+        size_t allocate(Callback&& callback, Trigger::Kind kind, Uint32 interval);
+        void bindKeys(size_t index, const SDL_Keycode* codes, size_t count);
+        void unbindKeys(size_t index);
+        void placeKeyEntry(const KeySlots& entry, size_t position); // points its slots to it
+        void removeKeyEntry(KeyEntries& list, size_t position); // the last one takes its place
+        void freeTrigger(size_t index);
+        void dropPending(); // its queued callbacks, none of them is called
+        void pack();
+        void packTrigger(size_t index);
+        size_t scanPacked(SDL_Keycode code); // into packedHits
+        std::vector<size_t>& nextCandidates(); // of the next matching, the ones being walked are deeper in candidates
+        Handle handleOf(size_t index) const;
+        void startTimer(size_t index, Uint32 now);
+        void expire(const TimerWheel::Timer& timer);
+        void release(SDL_Keycode code);
+        void advanceSequences(const SDL_Event& e);
+        bool isChordPrefix(Uint32 node) const;
+        void pruneSequences(Uint32 node); // from the node up, while no sequence needs them
+
+        // expects Trigger::keyboard to be already updated with the event,
+        // returns whether the lower priority groups should not see it
+        virtual bool processEvent(const SDL_Event& e);
+    };
+
+    // a fulfilled trigger waiting for its callback in deferred mode
+    struct PendingCallback {
+        Group* group; // NULL if the group got destroyed while dispatching
+        size_t trigger;
+        Uint32 generation; // not called if the trigger got unbound meanwhile
+        Uint32 epoch;      // nor if the group got reset or disabled
+
+        bool isCurrent() const; // its group and its binding still exist unchanged
+        void operator()() const;
+    };
 
-        void processEvent(SDL_Event& e);
+#ifdef SDL_TRIGGER_STATS
+    struct TriggerStatsSnapshot {
+        size_t trigger; // index in its group
+        Keycodes keys;
+        Uint64 evaluations;
+        Uint64 partialMatches;
+        Uint64 resets;
+        Uint64 fires;
+        Uint64 callbackTicks;
+        Uint64 maxCallbackTicks;
     };
-    extern Group globalGroup;
-    extern std::vector<Group*> groups;
 
-    void on(SDL_Keycode key, Callback callback);
-    void on(Keycodes keys, Callback callback);
+    struct GroupStatsSnapshot {
+        const Group* group;
+        Uint64 keypresses;
+        Uint64 fires;
+        std::vector<TriggerStatsSnapshot> triggers;
+    };
+#endif
+
+    // called with every keyboard event before it is processed, eg. to record them
+    using EventHook = void (*)(const SDL_Event& e, void* userdata);
+
+    // called with every queued callback right before it is called, eg. to count them
+    using DispatchHook = void (*)(const PendingCallback& callback, void* userdata);
+
+    // the groups, the keyboard state, the timers and the queued callbacks of
+    // one input stream, contexts share nothing, so eg. recorded sessions can
+    // be processed in parallel with a context per thread, the free functions
+    // below work on the default one
+    struct Context {
+        KeyboardState keyboard;
+        TimerWheel timers;
+        bool deferred;
+        EventHook eventHook;
+        void* eventHookUserdata;
+        std::vector<PendingCallback> pendingCallbacks;
+        std::vector<PendingCallback> dispatchedCallbacks; // being dispatched
+        std::atomic<Uint32> changes;
+        std::vector<Group*> groups; // by descending priority, guarded by groupsMutex
+
+        // callbacks may create, destroy and reprioritize groups while an event
+        // walks them, the list keeps its order until the outermost walk ends,
+        // meanwhile destroyed groups are NULL and the others are placed after
+        Uint32 walkDepth;
+        std::vector<Group*> placedAfterWalk; // in the order they asked for their place
+        bool hasDestroyedWhileWalking;
+        std::recursive_mutex groupsMutex;
+#ifdef SDL_TRIGGER_STATS
+        std::mutex statsMutex; // the groups and their bound keys change under it too, snapshots take only this one
+#endif
+        Group globalGroup; // of Trigger::on and the like in the default context
+
+        Context();
+
+        Context(const Context&) = delete;
+        Context& operator=(const Context&) = delete;
+
+        bool isKeyDown(SDL_Keycode key) const;
+        bool isScancodeDown(SDL_Scancode scancode) const;
+
+        // bumped by every processed keypress and release and by every change of
+        // the groups or their bindings, so eg. an overlay showing the key states
+        // only has to redraw when it differs from the count it was drawn at
+        Uint32 changeCount() const;
+
+        // in deferred mode fulfilled triggers are queued instead of called,
+        // until the application calls dispatchPending (eg. after polling events)
+        void setDeferred(bool isDeferred, size_t capacity = 256);
+        bool isDeferred() const;
+        size_t dispatchPending(DispatchHook hook = NULL, void* userdata = NULL); // returns the number of callbacks called
+        void takePending(std::vector<PendingCallback>& into); // instead of calling them
+
+#ifdef SDL_TRIGGER_STATS
+        // copies the counters out from any thread, even while events are
+        // processed, creating groups and binding keys wait for it to finish
+        std::vector<GroupStatsSnapshot> snapshotStats();
+#endif
+
+        void setEventHook(EventHook hook, void* userdata = NULL);
+
+        // expires hold and repeat timers, eg. with SDL_GetTicks() once per frame,
+        // events also advance the timers to their own timestamps
+        void tick(Uint32 now);
+
+        void processEvent(const SDL_Event& e);
+
+        // same as calling processEvent for each, eg. after SDL_PeepEvents
+        void processEvents(const SDL_Event* events, size_t count);
+        void processEvents(const std::vector<SDL_Event>& events);
+    };
+
+    // created on first use, so groups in static storage can register in it
+    Context& defaultContext();
+
+    // what PACKED groups run on this CPU, "avx2", "sse2" or "scalar"
+    const char* packedInstructions();
+
+    extern Group& globalGroup; // of the default context
+    extern std::vector<Group*>& groups;
+    extern std::recursive_mutex& groupsMutex;
+
+    Handle on(SDL_Keycode key, Callback callback);
+    Handle on(std::initializer_list<SDL_Keycode> keys, Callback callback);
+    Handle on(const Keycodes& keys, Callback callback);
+    Handle onScancode(SDL_Scancode scancode, Callback callback);
+    Handle onScancode(std::initializer_list<SDL_Scancode> scancodes, Callback callback);
+    Handle onModified(Uint16 modifiers, SDL_Keycode key, Callback callback);
+    Handle onSequence(std::initializer_list<std::initializer_list<SDL_Keycode>> steps, Callback callback);
+    Handle onSequence(const std::vector<Keycodes>& steps, Callback callback);
+    Handle onHold(std::initializer_list<SDL_Keycode> keys, Uint32 milliseconds, Callback callback);
+    Handle onHold(const Keycodes& keys, Uint32 milliseconds, Callback callback);
+    Handle onRepeat(std::initializer_list<SDL_Keycode> keys, Uint32 interval, Callback callback);
+    Handle onRepeat(const Keycodes& keys, Uint32 interval, Callback callback);
+    Handle onRelease(std::initializer_list<SDL_Keycode> keys, Callback callback);
+    Handle onRelease(const Keycodes& keys, Callback callback);
+    bool off(Handle handle);
+    void rebind(Handle handle, std::initializer_list<SDL_Keycode> keys);
+    void rebind(Handle handle, const Keycodes& keys);
+
+    template <void (*Function)()>
+    Handle on(std::initializer_list<SDL_Keycode> keys) {
+        return defaultContext().globalGroup.on<Function>(keys);
+    }
+
+    template <typename T, void (T::*Method)()>
+    Handle on(std::initializer_list<SDL_Keycode> keys, T& object) {
+        return defaultContext().globalGroup.on<T, Method>(keys, object);
+    }
+
+    bool isKeyDown(SDL_Keycode key);
+    bool isScancodeDown(SDL_Scancode scancode);
+    Uint32 changeCount();
+
+    void setDeferred(bool isDeferred, size_t capacity = 256);
+    bool isDeferred();
+    size_t dispatchPending();
+    void takePending(std::vector<PendingCallback>& into);
+
+#ifdef SDL_TRIGGER_STATS
+    std::vector<GroupStatsSnapshot> snapshotStats();
+#endif
 
-    void processEvent(SDL_Event& e);
+    void setEventHook(EventHook hook, void* userdata = NULL);
+    void tick(Uint32 now);
+    void processEvent(const SDL_Event& e);
+    void processEvents(const SDL_Event* events, size_t count);
+    void processEvents(const std::vector<SDL_Event>& events);
 } // namespace Trigger
 
 #endif /* SDL_TRIGGER_H */
\ No newline at end of file
@@ -0,0 +1,173 @@
+#ifndef SDL_TRIGGER_KEYMAP_H
+#define SDL_TRIGGER_KEYMAP_H
+
+#include "sdl_trigger.h"
+#include "sdl_trigger_replay.h"
+#include <memory>
+#include <string>
+
+namespace Trigger {
+
+    // the callbacks of keymaps by name, register them before loading the
+    // keymaps naming them, from the thread processing the events, a name
+    // registered again gets the new callback in the loaded keymaps too, even
+    // from its own callback, which is kept until it returns
+    class CallbackRegistry {
+    public:
+        // the callback of a name, shared with the keymaps naming it
+        struct Entry {
+            std::shared_ptr<Callback> callback;
+        };
+
+        void add(const std::string& name, Callback callback);
+        std::shared_ptr<Entry> find(const std::string& name) const; // NULL if not registered
+
+    private:
+        std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+    };
+
+    // a compiled keymap is a 40 byte header followed by little-endian
+    // arrays of 32 bit words, so a keymap can use the mapped file directly:
+    // the bindings, their keys, the index of the keys, the entries of the
+    // index and the offsets and the bytes of the callback names
+    struct KeymapHeader {
+        char magic[8];
+        Uint32 version;
+        Uint32 bindingCount;
+        Uint32 keyCount;
+        Uint32 indexCount;
+        Uint32 entryCount;
+        Uint32 callbackCount;
+        Uint32 nameBytes;
+        Uint32 padding;
+    };
+    static_assert(sizeof(KeymapHeader) == 40, "KeymapHeader must be packed into 40 bytes!");
+
+    struct KeymapBinding {
+        Uint32 firstKey;
+        Uint32 keyCount;
+        Uint32 callback;
+    };
+
+    // a key and its entries, the index is sorted by key
+    struct KeymapKey {
+        Sint32 key;
+        Uint32 firstEntry;
+        Uint32 entryCount;
+    };
+
+    // the slots of a binding holding the key, the entries of a key are sorted by binding
+    struct KeymapEntry {
+        Uint32 binding;
+        Uint32 slots;
+    };
+
+    extern const char KEYMAP_MAGIC[8];
+    const Uint32 KEYMAP_VERSION = 1;
+
+    // compiles a text keymap into a binary one, a line holds a binding,
+    // its keys joined by '+' and the name of its callback after a '=':
+    //
+    //     # comments and empty lines are skipped
+    //     Left Ctrl + S = quickSave
+    //     F5 = quickSave
+    //     0x40000057 = zoomIn
+    //
+    // keys are named like SDL_GetKeyName names them, or given as hex keycodes,
+    // a key whose name contains a '+' (eg. Keypad +) must be given as its
+    // keycode, errors are thrown with the path and the line. the keymap is
+    // replaced at once, so it can be compiled over one that is loaded
+    void compileKeymap(const std::string& textPath, const std::string& keymapPath);
+
+    // a mapped binary keymap with its callbacks resolved and the state of
+    // its bindings, checked when it is loaded, so matching never is
+    class Keymap {
+    public:
+        // like the KeyCombination and lastPress of a Trigger
+        struct State {
+            Uint32 downMask;
+            Uint32 lastPress;
+            Uint32 epoch;
+        };
+
+        Keymap(const std::string& path, CallbackRegistry& registry);
+
+        Keymap(const Keymap&) = delete;
+        Keymap& operator=(const Keymap&) = delete;
+
+        size_t bindingCount() const;
+        size_t keyCount(size_t binding) const;
+        SDL_Keycode keyOf(size_t binding, size_t slot) const;
+        const KeymapEntry* findEntries(SDL_Keycode key, size_t& entryCount) const; // NULL if no binding has it
+
+        std::shared_ptr<Callback> callbackOf(size_t binding) const;
+        State& stateOf(size_t binding);
+
+    private:
+        MappedFile file;
+        const KeymapBinding* bindings;
+        const Sint32* keys;
+        const KeymapKey* index;
+        const KeymapEntry* entries;
+        size_t count;
+        size_t indexCount;
+        std::vector<std::shared_ptr<CallbackRegistry::Entry>> callbacks; // by the callback ids of the file
+        std::vector<State> states;
+    };
+
+    // the bindings of a keymap as a group, eg.
+    //
+    //     Trigger::CallbackRegistry registry;
+    //     registry.add("quickSave", quickSave);
+    //
+    //     Trigger::KeymapGroup keymap(registry);
+    //     keymap.load("keys.keymap");
+    //
+    // loading allocates a few arrays, not a single one per binding. it
+    // matches exactly like a Group with the same on() bindings, and it is
+    // processed with the other groups, by priority, in deferred mode and in
+    // pipelines
+    class KeymapGroup : private Group {
+    public:
+        using Group::isEnabled;
+        using Group::enable;
+        using Group::disable;
+        using Group::toggle;
+        using Group::reset;
+        using Group::setPriority;
+        using Group::setConsuming;
+
+        explicit KeymapGroup(CallbackRegistry& registry, Context& context = defaultContext());
+        ~KeymapGroup();
+
+        // as a group, eg. to compare with PendingCallback::group
+        const Group& group() const;
+
+        // takes the keymap over now, from its callbacks too, then the rest of
+        // the current one is not matched against the event anymore
+        void load(const std::string& path);
+
+        // loads the keymap on the calling thread, any thread, and the group
+        // takes it over before its next event, a failed reload throws and
+        // keeps the current keymap, both unbind the bindings of the current
+        // one, so its queued callbacks are not called anymore (but stop a
+        // pipeline first, its callbacks are fixed while it runs)
+        void reload(const std::string& path);
+
+        const Keymap* keymap() const; // NULL until one is loaded
+
+        bool processEvent(const SDL_Event& e) override;
+        bool isCurrent(size_t index, Uint32 generation) const override;
+        void fire(size_t index) override;
+
+    private:
+        void takeOver(Keymap* next);
+
+        CallbackRegistry& registry;
+        std::unique_ptr<Keymap> loaded;
+        std::atomic<Keymap*> pending; // reloaded, waiting for the next event
+    };
+
+} // namespace Trigger
+
+#endif /* SDL_TRIGGER_KEYMAP_H */
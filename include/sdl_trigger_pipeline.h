@@ -0,0 +1,113 @@
+#ifndef SDL_TRIGGER_PIPELINE_H
+#define SDL_TRIGGER_PIPELINE_H
+
+#include "sdl_trigger.h"
+#include <mutex>
+#include <thread>
+
+namespace Trigger {
+
+    // lock-free ring for exactly one producer and one consumer thread
+    template <typename T>
+    class SpscRing {
+    public:
+        explicit SpscRing(size_t capacity) : mask{roundUp(capacity) - 1}, slots(mask + 1), head{0}, tail{0} {
+            //
+        }
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        // producer side, returns false if the ring is full
+        bool push(const T& item) {
+            const size_t position = tail.load(std::memory_order_relaxed);
+            if (position - head.load(std::memory_order_acquire) > mask) {
+                return false;
+            }
+
+            slots[position & mask] = item;
+            tail.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, returns false if the ring is empty
+        bool pop(T& item) {
+            const size_t position = head.load(std::memory_order_relaxed);
+            if (position == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            item = slots[position & mask];
+            head.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool isEmpty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const {
+            return mask + 1;
+        }
+
+    private:
+        static size_t roundUp(size_t capacity) {
+            size_t rounded = 1;
+            while (rounded < capacity) {
+                rounded <<= 1;
+            }
+            return rounded;
+        }
+
+        const size_t mask;
+        std::vector<T> slots;
+
+        // on separate cache lines, so the two threads don't fight over them
+        alignas(64) std::atomic<size_t> head;
+        alignas(64) std::atomic<size_t> tail;
+    };
+
+    // matches events on a worker thread: the SDL thread pushes events, the
+    // worker runs processEvents of the context in deferred mode, and the
+    // consumer thread calls the callbacks of the fulfilled triggers with dispatch()
+    //
+    // bindings should be registered before start(), groups have to outlive
+    // the pipeline, but they can be enabled/disabled from any thread
+    //
+    // the consumer thread may stop the pipeline while the ring of the
+    // fulfilled triggers is full, the ones not fitting are called by the
+    // next dispatch(), after the ones in the ring
+    class Pipeline {
+    public:
+        explicit Pipeline(size_t capacity = 1024, Context& context = defaultContext());
+        ~Pipeline();
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        void start();
+        void stop(); // waits until every pushed event is matched
+
+        bool push(const SDL_Event& e); // SDL thread, false if the ring is full
+        size_t dispatch();             // consumer thread, returns the number of callbacks called
+
+        Uint64 matchedEvents() const;
+
+    private:
+        void run();
+
+        Context& context;
+        SpscRing<SDL_Event> events;
+        SpscRing<PendingCallback> fulfilled;
+        std::atomic<bool> isRunning;
+        std::atomic<Uint64> matched;
+        std::mutex spillMutex;
+        std::vector<PendingCallback> spilled; // did not fit into the ring while stopping
+        std::atomic<bool> hasSpilled;
+        bool wasDeferred;
+        std::thread worker;
+    };
+
+} // namespace Trigger
+
+#endif /* SDL_TRIGGER_PIPELINE_H */
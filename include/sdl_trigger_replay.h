@@ -0,0 +1,112 @@
+#ifndef SDL_TRIGGER_REPLAY_H
+#define SDL_TRIGGER_REPLAY_H
+
+#include "sdl_trigger.h"
+#include <string>
+
+namespace Trigger {
+
+    // a capture is a 16 byte header followed by 16 byte little-endian
+    // records, so a replay can use the mapped file directly
+    struct RecordedEvent {
+        Uint32 timestamp;
+        Sint32 key;
+        Uint16 scancode;
+        Uint16 mod;
+        Uint8 isDown;
+        Uint8 repeat;
+        Uint16 padding;
+
+        static RecordedEvent of(const SDL_Event& e);
+        SDL_Event toEvent() const;
+    };
+    static_assert(sizeof(RecordedEvent) == 16, "RecordedEvent must be packed into 16 bytes!");
+
+    extern const char RECORDING_MAGIC[8];
+    const Uint32 RECORDING_VERSION = 1;
+
+    // read-only view of a whole file, memory-mapped where possible,
+    // otherwise it is read front to back or looked up all over
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path, bool isSequential = true);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const Uint8* data() const;
+        size_t size() const;
+
+    private:
+        const Uint8* bytes;
+        size_t length;
+        bool isMapped; // otherwise read into memory
+    };
+
+    // streams every keyboard event seen by the context into a file
+    class Recorder {
+    public:
+        static const size_t BUFFERED_EVENTS = 4096;
+
+        explicit Recorder(const std::string& path, Context& context = defaultContext());
+        ~Recorder(); // stops and flushes
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        void start();
+        void stop();
+        void flush();
+
+        Uint64 recordedEvents() const;
+
+    private:
+        static void record(const SDL_Event& e, void* recorder);
+
+        Context& context;
+        SDL_RWops* file;
+        std::vector<RecordedEvent> buffer;
+        Uint64 recorded;
+        bool isRecording;
+    };
+
+    // feeds a capture back through the context, and counts how many times
+    // each trigger fired, so it can serve as a regression fixture
+    class Replayer {
+    public:
+        enum Speed {
+            AS_FAST_AS_POSSIBLE,
+            REAL_TIME
+        };
+
+        struct FireCount {
+            const Group* group;
+            size_t trigger;
+            Uint64 count;
+        };
+
+        explicit Replayer(const std::string& path, Context& context = defaultContext());
+
+        size_t eventCount() const;
+        SDL_Event eventAt(size_t index) const;
+
+        // returns the number of callbacks called
+        Uint64 run(Speed speed = AS_FAST_AS_POSSIBLE);
+
+        // in the order of the groups and their triggers, only triggers that fired
+        std::vector<FireCount> fireCounts() const;
+
+    private:
+        static void countFire(const PendingCallback& callback, void* replayer);
+
+        Context& context;
+        MappedFile file;
+        const RecordedEvent* events;
+        size_t count;
+        std::unordered_map<const Group*, std::vector<Uint64>> fired;
+    };
+
+} // namespace Trigger
+
+#endif /* SDL_TRIGGER_REPLAY_H */
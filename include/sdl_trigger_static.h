@@ -0,0 +1,175 @@
+#ifndef SDL_TRIGGER_STATIC_H
+#define SDL_TRIGGER_STATIC_H
+
+#include "sdl_trigger.h"
+
+namespace Trigger {
+
+    // bitmask of the slots holding a key, one comparison per slot
+    template <size_t Slot, SDL_Keycode... Keys>
+    struct SlotsOfKey;
+
+    template <size_t Slot>
+    struct SlotsOfKey<Slot> {
+        static Uint32 of(SDL_Keycode) {
+            return 0;
+        }
+    };
+
+    template <size_t Slot, SDL_Keycode Key, SDL_Keycode... Rest>
+    struct SlotsOfKey<Slot, Key, Rest...> {
+        static Uint32 of(SDL_Keycode key) {
+            return (key == Key ? Uint32{1} << Slot : 0) | SlotsOfKey<Slot + 1, Rest...>::of(key);
+        }
+    };
+
+    template <SDL_Keycode... Keys>
+    struct KeysDown;
+
+    template <>
+    struct KeysDown<> {
+        static bool check(const KeyboardState&) {
+            return true;
+        }
+    };
+
+    template <SDL_Keycode Key, SDL_Keycode... Rest>
+    struct KeysDown<Key, Rest...> {
+        static bool check(const KeyboardState& keyboard) {
+            return keyboard.isKeyDown(Key) && KeysDown<Rest...>::check(keyboard);
+        }
+    };
+
+    // a combination and the function it calls, known at compile time
+    template <void (*Function)(), SDL_Keycode... Keys>
+    struct Binding {
+        static const size_t KEY_COUNT = sizeof...(Keys);
+        static_assert(KEY_COUNT <= KeyCombination::MAX_KEYS, "Too many keys in a single key combination!");
+
+        static const Uint32 FULFILLED_MASK = KEY_COUNT == KeyCombination::MAX_KEYS ? ~Uint32{0} : (Uint32{1} << KEY_COUNT) - 1;
+
+        static Uint32 slotsOf(SDL_Keycode key) {
+            return SlotsOfKey<0, Keys...>::of(key);
+        }
+
+        static bool areKeysDown(const KeyboardState& keyboard) {
+            return KeysDown<Keys...>::check(keyboard);
+        }
+
+        static void call() {
+            Function();
+        }
+    };
+
+    // a group of bindings fixed at compile time, eg.
+    //
+    //     Trigger::StaticGroup<
+    //         Trigger::Binding<quit, SDLK_q>,
+    //         Trigger::Binding<save, SDLK_LCTRL, SDLK_s>
+    //     > menuBindings;
+    //
+    // the key tests of every binding are unrolled into one matcher and its
+    // state is a zeroed array, so nothing is built at startup. it matches
+    // exactly like a Group with the same on() bindings, and it is processed
+    // with the other groups, by priority, in deferred mode and in pipelines
+    template <typename... Bindings>
+    class StaticGroup : private Group {
+    public:
+        static const size_t BINDING_COUNT = sizeof...(Bindings);
+        static_assert(BINDING_COUNT > 0, "StaticGroup without bindings!");
+
+        using Group::isEnabled;
+        using Group::enable;
+        using Group::disable;
+        using Group::toggle;
+        using Group::reset;
+        using Group::setPriority;
+        using Group::setConsuming;
+
+        StaticGroup() : Group(), states{} {
+            //
+        }
+
+        explicit StaticGroup(Context& context) : Group(context), states{} {
+            //
+        }
+
+        // as a group, eg. to compare with PendingCallback::group
+        const Group& group() const {
+            return *this;
+        }
+
+        bool processEvent(const SDL_Event& e) override {
+            hasFulfilled = false;
+
+            if (e.type == SDL_KEYDOWN && e.key.repeat == 0) {
+#ifdef SDL_TRIGGER_STATS
+                stats.keypresses.add(1);
+#endif
+
+                const SDL_Keycode key = e.key.keysym.sym;
+                const Uint32 press = context.keyboard.presses;
+                const Uint32 current = epoch;
+
+                // a braced list is evaluated in order, so are the callbacks
+                size_t index = 0;
+                const bool unrolled[] = {evaluate<Bindings>(index++, key, press, current)...};
+                (void)unrolled;
+            }
+
+            return isConsuming && hasFulfilled;
+        }
+
+        // its bindings are never unbound, so a queued callback is only
+        // dropped by a reset, by the epoch it got queued in
+        bool isCurrent(size_t, Uint32) const override {
+            return true;
+        }
+
+        void fire(size_t index) override {
+            static void (* const calls[])() = {&Bindings::call...};
+            calls[index]();
+        }
+
+    private:
+        // like the KeyCombination and lastPress of a Trigger
+        struct State {
+            Uint32 downMask;
+            Uint32 lastPress;
+            Uint32 epoch;
+        };
+
+        template <typename B>
+        bool evaluate(size_t index, SDL_Keycode key, Uint32 press, Uint32 current) {
+            State& state = states[index];
+
+            if (B::KEY_COUNT > 0) {
+                const Uint32 slots = B::slotsOf(key);
+                if (slots == 0) {
+                    return false;
+                }
+
+                // any other key pressed since resets the combination
+                if (state.epoch != current || state.lastPress == 0 || state.lastPress + 1 != press) {
+                    state.downMask = 0;
+                    state.epoch = current;
+                }
+                state.lastPress = press;
+                state.downMask |= slots;
+
+                // a callback may have reset the group meanwhile
+                if (state.downMask != B::FULFILLED_MASK || state.epoch != epoch || !B::areKeysDown(context.keyboard)) {
+                    return false;
+                }
+            }
+
+            fulfil(index, 0);
+            return true;
+        }
+
+        State states[BINDING_COUNT];
+    };
+
+} // namespace Trigger
+
+#endif /* SDL_TRIGGER_STATIC_H */
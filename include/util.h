@@ -3,6 +3,8 @@
 
 #include <string>
 #include <list>
+#include <unordered_map>
+#include <vector>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 
@@ -23,7 +25,52 @@ struct Surface {
     static int colorFor(int r, int g, int b);
     static int colorFor(SDL_Color color);
 
+    // composed of the cached glyphs, the caller frees it
     static SDL_Surface* ofText(const char* string, SDL_Color color = {150, 150, 150});
+
+    // owned by the text cache, valid until TextCache::CAPACITY other texts are asked for
+    static SDL_Surface* ofCachedText(const std::string& string, SDL_Color color = {150, 150, 150});
+
+    // blits the cached glyphs straight onto the target, nothing is allocated
+    static void drawText(SDL_Surface* target, const char* string, int x, int y, SDL_Color color = {150, 150, 150});
+};
+
+// every (font, glyph, color) is rasterized once into shared atlas pages,
+// text is composed by blitting the cached glyphs next to each other
+struct GlyphAtlas {
+    static const int PAGE_SIZE = 256;
+
+    struct Glyph {
+        SDL_Surface* page;
+        SDL_Rect rect;
+    };
+
+    static std::vector<SDL_Surface*> pages;
+    static std::unordered_map<Uint32, Glyph> glyphs; // by color and character
+    static int cursorX;
+    static int cursorY;
+    static int rowHeight;
+
+    static bool canCompose(const char* string); // printable ASCII only, the rest is rendered at once
+    static const Glyph& find(char character, SDL_Color color);
+    static int widthOf(const char* string, SDL_Color color);
+    static void clear();
+};
+
+// least recently used texts, for labels rendered every frame
+struct TextCache {
+    static const size_t CAPACITY = 64;
+
+    struct Entry {
+        std::string key;
+        SDL_Surface* surface;
+    };
+
+    static std::list<Entry> entries; // the most recently used first
+    static std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+    static SDL_Surface* find(const std::string& string, SDL_Color color);
+    static void clear();
 };
 
 struct KeyPressLog {
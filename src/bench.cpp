@@ -0,0 +1,1133 @@
+#include "sdl_trigger.h"
+#include "sdl_trigger_keymap.h"
+#include "sdl_trigger_pipeline.h"
+#include "sdl_trigger_replay.h"
+#include "sdl_trigger_static.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+
+// headless benchmarks of the trigger engine, every result is printed as a
+// JSON object on its own line (to stdout or to the file given with -o)
+
+static std::atomic<Uint64> allocations{0};
+
+// the replaced allocation functions count every allocation, they are kept
+// out of line, otherwise the compiler sees malloc and free through them
+// and takes them for a mismatch of new and delete
+#if defined(__GNUC__)
+#define BENCH_OUT_OF_LINE __attribute__((noinline))
+#else
+#define BENCH_OUT_OF_LINE
+#endif
+
+static void* countedMalloc(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+BENCH_OUT_OF_LINE void* operator new(size_t size) {
+    if (void* memory = countedMalloc(size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+// eg. the temporary buffers of std::inplace_merge
+BENCH_OUT_OF_LINE void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedMalloc(size);
+}
+
+BENCH_OUT_OF_LINE void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+BENCH_OUT_OF_LINE void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+BENCH_OUT_OF_LINE void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+enum Binding {
+    COMBINATIONS,
+    SEQUENCES, // two steps, the second one a single key
+    HOLDS      // combinations held for up to a second
+};
+
+struct Workload {
+    std::string name;
+    size_t bindings;
+    size_t keysPerBinding;
+    size_t groups;
+    double enabledRatio;
+    size_t events;
+    Binding binding;
+    bool isLayered; // descending priorities, every group consumes the keys it fires on
+    bool isToggled; // every group is disabled and enabled again before each event
+    Trigger::Group::Matching matching;
+    size_t threads; // each with its own context, 0 for one thread in the default context
+    Trigger::Group::Evaluation evaluation;
+};
+
+struct Result {
+    double nsPerEvent;
+    double allocationsPerEvent;
+    Uint64 callbacks;
+    double callbacksPerSecond;
+};
+
+static FILE* output = stdout;
+static const size_t KEY_COUNT = 64;
+
+static SDL_Keycode keyAt(size_t index) {
+    // letters and digits, then keys with SDLK_SCANCODE_MASK, like the F keys
+    if (index < 26) {
+        return 'a' + index;
+    } else if (index < 36) {
+        return '0' + (index - 26);
+    }
+
+    const SDL_Scancode scancode = SDL_Scancode(SDL_SCANCODE_Z + 1 + index);
+    return SDL_SCANCODE_TO_KEYCODE(scancode);
+}
+
+static SDL_Event keyEvent(Uint32 type, SDL_Keycode key, Uint32 timestamp) {
+    SDL_Event e;
+    std::memset(&e, 0, sizeof(e));
+    e.type = type;
+    e.key.timestamp = timestamp;
+    e.key.state = type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+    e.key.keysym.sym = key;
+    e.key.keysym.scancode = SDL_GetScancodeFromKey(key);
+    return e;
+}
+
+// typing with occasional chords, plus some mouse motion to be filtered out
+static std::vector<SDL_Event> generateEvents(size_t count, std::mt19937& random) {
+    std::vector<SDL_Event> events;
+    events.reserve(count + 8);
+
+    Uint32 timestamp = 0;
+    while (events.size() < count) {
+        timestamp += 1 + random() % 30;
+
+        if (random() % 10 == 0) {
+            SDL_Event motion;
+            std::memset(&motion, 0, sizeof(motion));
+            motion.type = SDL_MOUSEMOTION;
+            motion.motion.timestamp = timestamp;
+            events.push_back(motion);
+            continue;
+        }
+
+        const size_t chord = 1 + (random() % 4 == 0 ? random() % 3 : 0);
+        SDL_Keycode keys[3];
+        for (size_t i = 0; i < chord; i++) {
+            keys[i] = keyAt(random() % KEY_COUNT);
+            events.push_back(keyEvent(SDL_KEYDOWN, keys[i], timestamp++));
+        }
+        for (size_t i = chord; i > 0; i--) {
+            events.push_back(keyEvent(SDL_KEYUP, keys[i - 1], timestamp++));
+        }
+    }
+
+    return events;
+}
+
+static void bind(std::vector<std::unique_ptr<Trigger::Group>>& groups, const Workload& workload, Uint64& counter, std::mt19937& random,
+                 Trigger::Context& context = Trigger::defaultContext()) {
+    for (size_t i = 0; i < workload.groups; i++) {
+        groups.emplace_back(new Trigger::Group(context, workload.matching));
+        groups.back()->setEvaluation(workload.evaluation);
+    }
+
+    for (size_t i = 0; i < workload.bindings; i++) {
+        SDL_Keycode keys[Trigger::KeyCombination::MAX_KEYS];
+        for (size_t k = 0; k < workload.keysPerBinding; k++) {
+            keys[k] = keyAt(random() % KEY_COUNT);
+        }
+
+        if (workload.binding == SEQUENCES) {
+            const std::vector<Trigger::Keycodes> steps = {
+                Trigger::Keycodes(keys, keys + workload.keysPerBinding),
+                Trigger::Keycodes{keyAt(random() % KEY_COUNT)}
+            };
+
+            groups[i % workload.groups]->onSequence(steps, [&counter]() {
+                counter++;
+            });
+        } else if (workload.binding == HOLDS) {
+            groups[i % workload.groups]->onHold(Trigger::Keycodes(keys, keys + workload.keysPerBinding), 1 + random() % 1000, [&counter]() {
+                counter++;
+            });
+        } else {
+            groups[i % workload.groups]->on(keys, workload.keysPerBinding, [&counter]() {
+                counter++;
+            });
+        }
+    }
+
+    if (workload.isLayered) {
+        for (size_t i = 0; i < workload.groups; i++) {
+            groups[i]->setPriority(workload.groups - i);
+            groups[i]->setConsuming(true);
+        }
+    }
+
+    const size_t enabled = workload.groups * workload.enabledRatio + 0.5;
+    for (size_t i = enabled; i < workload.groups; i++) {
+        groups[i]->disable();
+    }
+}
+
+static Result measure(const Workload& workload) {
+    std::mt19937 random(1234);
+    const std::vector<SDL_Event> events = generateEvents(workload.events, random);
+
+    Uint64 counter = 0;
+    std::vector<std::unique_ptr<Trigger::Group>> groups;
+    bind(groups, workload, counter, random);
+    Trigger::keyboard.reset();
+    Trigger::timers.reset();
+
+    // one warm-up pass, so the scratch buffers are already grown
+    Trigger::processEvents(events);
+    counter = 0;
+
+    // the measured pass continues the timeline of the warm-up pass
+    std::vector<SDL_Event> laterEvents = events;
+    for (auto& e : laterEvents) {
+        e.common.timestamp += events.back().common.timestamp + 1;
+    }
+
+    const Uint64 allocationsBefore = allocations.load();
+    const Uint64 start = SDL_GetPerformanceCounter();
+
+    if (workload.isToggled) {
+        for (const auto& e : laterEvents) {
+            for (auto& group : groups) {
+                group->disable();
+                group->enable();
+            }
+            Trigger::processEvent(e);
+        }
+    } else {
+        Trigger::processEvents(laterEvents);
+    }
+
+    const Uint64 end = SDL_GetPerformanceCounter();
+    const Uint64 allocated = allocations.load() - allocationsBefore;
+
+    const double seconds = double(end - start) / SDL_GetPerformanceFrequency();
+
+    Result result;
+    result.nsPerEvent = seconds * 1e9 / events.size();
+    result.allocationsPerEvent = double(allocated) / events.size();
+    result.callbacks = counter;
+    result.callbacksPerSecond = seconds > 0 ? counter / seconds : 0;
+    return result;
+}
+
+// with the instructions actually used by a packed one
+static std::string evaluationName(Trigger::Group::Evaluation evaluation) {
+    switch (evaluation) {
+        case Trigger::Group::PACKED:
+            return std::string("packed_") + Trigger::packedInstructions();
+        case Trigger::Group::PACKED_SCALAR:
+            return "packed_scalar";
+        default:
+            return "indexed";
+    }
+}
+
+static void report(const Workload& workload, const Result& result) {
+    fprintf(output,
+            "{\"workload\": \"%s\", \"bindings\": %zu, \"keys_per_binding\": %zu, \"groups\": %zu, \"enabled_ratio\": %.2f, \"threads\": %zu, \"evaluation\": \"%s\", "
+            "\"events\": %zu, \"ns_per_event\": %.2f, \"allocations_per_event\": %.4f, \"callbacks\": %llu, \"callbacks_per_second\": %.0f}\n",
+            workload.name.c_str(), workload.bindings, workload.keysPerBinding, workload.groups, workload.enabledRatio, std::max<size_t>(workload.threads, 1),
+            evaluationName(workload.evaluation).c_str(),
+            workload.events, result.nsPerEvent, result.allocationsPerEvent, (unsigned long long)result.callbacks, result.callbacksPerSecond);
+    fflush(output);
+}
+
+// the same stream through the pipeline, with a producer thread pushing
+// events as fast as it can, must give exactly the inline callback count
+static bool stressPipeline(size_t eventCount) {
+    Workload workload = {"pipeline_stress", 1000, 2, 10, 0.8, eventCount, COMBINATIONS};
+
+    std::mt19937 random(4321);
+    const std::vector<SDL_Event> events = generateEvents(workload.events, random);
+
+    Uint64 counter = 0;
+    std::vector<std::unique_ptr<Trigger::Group>> groups;
+    bind(groups, workload, counter, random);
+
+    Trigger::keyboard.reset();
+    Trigger::processEvents(events);
+    const Uint64 expected = counter;
+
+    counter = 0;
+    for (auto& group : groups) {
+        group->reset();
+    }
+    Trigger::keyboard.reset();
+
+    Trigger::Pipeline pipeline(256);
+    pipeline.start();
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+
+    std::thread producer([&pipeline, &events]() {
+        for (const auto& e : events) {
+            while (!pipeline.push(e)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::atomic<bool> isProducing{true};
+    std::thread stopper([&pipeline, &producer, &isProducing]() {
+        producer.join();
+        pipeline.stop();
+        isProducing = false;
+    });
+
+    while (isProducing) {
+        pipeline.dispatch();
+    }
+    stopper.join();
+    pipeline.dispatch();
+
+    const double seconds = double(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    Result result;
+    result.nsPerEvent = seconds * 1e9 / events.size();
+    result.allocationsPerEvent = 0;
+    result.callbacks = counter;
+    result.callbacksPerSecond = seconds > 0 ? counter / seconds : 0;
+    report(workload, result);
+
+    if (counter != expected) {
+        fprintf(stderr, "pipeline_stress: %llu callbacks instead of %llu!\n", (unsigned long long)counter, (unsigned long long)expected);
+        return false;
+    }
+
+    return true;
+}
+
+// the consumer thread stopping the pipeline while the callbacks of one
+// keypress overflow the ring, none of them is lost
+static bool stopFullPipeline() {
+    static const size_t CAPACITY = 4;
+    Trigger::keyboard.reset();
+
+    Trigger::Group group;
+    size_t called = 0;
+    for (size_t i = 0; i < 2 * CAPACITY; i++) {
+        group.on('a', [&called]() {
+            called++;
+        });
+    }
+
+    Trigger::Pipeline pipeline(CAPACITY);
+    pipeline.start();
+    pipeline.push(keyEvent(SDL_KEYDOWN, 'a', 0));
+    pipeline.push(keyEvent(SDL_KEYUP, 'a', 0));
+    pipeline.stop();
+    pipeline.dispatch();
+
+    Trigger::keyboard.reset();
+
+    if (called != 2 * CAPACITY) {
+        fprintf(stderr, "pipeline_stop: %zu callbacks instead of %zu!\n", called, 2 * CAPACITY);
+        return false;
+    }
+
+    return true;
+}
+
+// the same stream through a context per thread, with up to one thread per
+// core, every context must give exactly the callback count of the default one
+static bool scaleContexts(size_t eventCount) {
+    Workload workload = {"parallel_contexts", 1000, 2, 10, 1.0, eventCount, COMBINATIONS};
+
+    std::mt19937 random(8765);
+    const std::vector<SDL_Event> events = generateEvents(workload.events, random);
+
+    Uint64 expected = 0;
+    {
+        std::mt19937 bindings(5678);
+        std::vector<std::unique_ptr<Trigger::Group>> groups;
+        bind(groups, workload, expected, bindings);
+
+        Trigger::keyboard.reset();
+        Trigger::processEvents(events);
+        Trigger::keyboard.reset();
+    }
+
+    const size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    bool isCorrect = true;
+
+    for (size_t threads = 1;; threads = std::min(threads * 2, cores)) {
+        workload.threads = threads;
+        std::vector<Uint64> counters(threads, 0);
+        std::vector<std::thread> workers;
+
+        const Uint64 start = SDL_GetPerformanceCounter();
+
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&workload, &events, &counters, t]() {
+                // the groups go before their context
+                Trigger::Context context;
+                std::vector<std::unique_ptr<Trigger::Group>> groups;
+
+                // a local counter, the counters share cache lines
+                Uint64 counter = 0;
+                std::mt19937 bindings(5678);
+                bind(groups, workload, counter, bindings, context);
+                context.processEvents(events);
+
+                counters[t] = counter;
+            });
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        const double seconds = double(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+        Uint64 callbacks = 0;
+        for (size_t t = 0; t < threads; t++) {
+            callbacks += counters[t];
+            if (counters[t] != expected) {
+                fprintf(stderr, "parallel_contexts: %llu callbacks instead of %llu in thread %zu of %zu!\n",
+                        (unsigned long long)counters[t], (unsigned long long)expected, t, threads);
+                isCorrect = false;
+            }
+        }
+
+        // every event of every thread, so a linear scaling keeps it flat
+        Result result;
+        result.nsPerEvent = seconds * 1e9 / (events.size() * threads);
+        result.allocationsPerEvent = 0;
+        result.callbacks = callbacks;
+        result.callbacksPerSecond = seconds > 0 ? callbacks / seconds : 0;
+        report(workload, result);
+
+        if (threads == cores) {
+            break;
+        }
+    }
+
+    return isCorrect;
+}
+
+// one event per binding loaded
+template <typename Load>
+static void measureLoad(const char* name, size_t bindings, Load load) {
+    const Uint64 allocationsBefore = allocations.load();
+    const Uint64 start = SDL_GetPerformanceCounter();
+    load();
+    const double seconds = double(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    Workload workload = {name, bindings, 2, 1, 1.0, bindings, COMBINATIONS};
+    Result result;
+    result.nsPerEvent = seconds * 1e9 / bindings;
+    result.allocationsPerEvent = double(allocations.load() - allocationsBefore) / bindings;
+    result.callbacks = 0;
+    result.callbacksPerSecond = 0;
+    report(workload, result);
+}
+
+// the same bindings loaded from a compiled keymap and through on() calls,
+// each result is per binding loaded, then both have to call the same
+// callbacks, and events are processed while another thread reloads it
+static bool loadKeymap(size_t eventCount, const std::string& path) {
+    static const size_t BINDINGS = 50000;
+    static const size_t CALLBACKS = 16;
+
+    std::mt19937 random(4321);
+    std::vector<Trigger::Keycodes> bindings(BINDINGS);
+    for (auto& keys : bindings) {
+        keys = {keyAt(random() % KEY_COUNT), keyAt(random() % KEY_COUNT)};
+    }
+    const std::vector<SDL_Event> events = generateEvents(eventCount, random);
+
+    // keycodes, so it does not depend on the key names
+    const std::string textPath = path + ".txt";
+    const auto writeText = [&](size_t count) {
+        FILE* text = fopen(textPath.c_str(), "w");
+        if (text == NULL) {
+            fprintf(stderr, "Could not create %s!\n", textPath.c_str());
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            fprintf(text, "0x%X + 0x%X = count%zu\n", bindings[i][0], bindings[i][1], i % CALLBACKS);
+        }
+        fclose(text);
+        return true;
+    };
+    if (!writeText(BINDINGS)) {
+        return false;
+    }
+
+    Trigger::Context onContext;
+    Trigger::Context keymapContext;
+    Uint64 onCounter = 0;
+    Uint64 keymapCounter = 0;
+
+    Trigger::CallbackRegistry registry;
+    for (size_t i = 0; i < CALLBACKS; i++) {
+        registry.add("count" + std::to_string(i), [&keymapCounter]() {
+            keymapCounter++;
+        });
+    }
+
+    Trigger::Group onGroup(onContext);
+    Trigger::KeymapGroup keymapGroup(registry, keymapContext);
+
+    measureLoad("load_on", BINDINGS, [&]() {
+        for (const auto& keys : bindings) {
+            onGroup.on(keys, [&onCounter]() {
+                onCounter++;
+            });
+        }
+    });
+    measureLoad("keymap_compile", BINDINGS, [&]() {
+        Trigger::compileKeymap(textPath, path);
+    });
+    measureLoad("keymap_load", BINDINGS, [&]() {
+        keymapGroup.load(path);
+    });
+
+    onContext.processEvents(events);
+    keymapContext.processEvents(events);
+
+    // a shorter one compiled over the loaded keymap, which keeps its mapped bytes
+    if (!writeText(BINDINGS / 10)) {
+        return false;
+    }
+    Trigger::compileKeymap(textPath, path);
+
+    onContext.processEvents(events);
+    keymapContext.processEvents(events);
+
+    bool isCorrect = keymapCounter == onCounter;
+    if (!isCorrect) {
+        fprintf(stderr, "keymap_load: %llu callbacks instead of %llu!\n", (unsigned long long)keymapCounter, (unsigned long long)onCounter);
+    }
+
+    // the whole one again for the reloads
+    if (!writeText(BINDINGS)) {
+        return false;
+    }
+    Trigger::compileKeymap(textPath, path);
+
+    // every reload loses the keys pressed so far, so only fewer callbacks are possible
+    keymapCounter = 0;
+    keymapContext.keyboard.reset();
+
+    std::atomic<bool> isDone{false};
+    size_t reloads = 0;
+    std::thread reloader([&]() {
+        while (!isDone) {
+            keymapGroup.reload(path);
+            reloads++;
+            SDL_Delay(1);
+        }
+    });
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    keymapContext.processEvents(events);
+    const double seconds = double(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    isDone = true;
+    reloader.join();
+
+    Workload workload = {"keymap_reload", BINDINGS, 2, 1, 1.0, events.size(), COMBINATIONS};
+    Result result;
+    result.nsPerEvent = seconds * 1e9 / events.size();
+    result.allocationsPerEvent = 0;
+    result.callbacks = keymapCounter;
+    result.callbacksPerSecond = seconds > 0 ? keymapCounter / seconds : 0;
+    report(workload, result);
+
+    if (keymapCounter > onCounter || keymapGroup.keymap() == NULL || keymapGroup.keymap()->bindingCount() != BINDINGS) {
+        fprintf(stderr, "keymap_reload: %llu callbacks after %zu reloads, at most %llu expected!\n",
+                (unsigned long long)keymapCounter, reloads, (unsigned long long)onCounter);
+        isCorrect = false;
+    }
+
+    std::remove(textPath.c_str());
+    std::remove(path.c_str());
+
+    return isCorrect;
+}
+
+// keymap callbacks replacing themselves in the registry and taking another
+// keymap over while they run, the replaced ones are kept until they return
+static bool replaceFromCallbacks(const std::string& path) {
+    const std::string textPath = path + ".txt";
+    const std::string otherPath = path + ".other";
+    const auto compile = [&](const char* text, const std::string& keymapPath) {
+        FILE* file = fopen(textPath.c_str(), "w");
+        if (file == NULL) {
+            fprintf(stderr, "Could not create %s!\n", textPath.c_str());
+            return false;
+        }
+        fputs(text, file);
+        fclose(file);
+        Trigger::compileKeymap(textPath, keymapPath);
+        return true;
+    };
+    if (!compile("0x61 = self\n0x61 = load\n0x61 = count\n", path) || !compile("0x61 = self\n0x61 = count\n", otherPath)) {
+        return false;
+    }
+
+    Trigger::Context context;
+    Trigger::CallbackRegistry registry;
+    Trigger::KeymapGroup group(registry, context);
+
+    // owned by the callback only, so it is gone if the running callback is destroyed
+    std::vector<std::string> called;
+    auto first = std::make_shared<std::string>("self");
+    registry.add("self", [&registry, &called, first]() {
+        registry.add("self", [&called]() {
+            called.push_back("replaced");
+        });
+        called.push_back(*first);
+    });
+    first.reset();
+    registry.add("load", [&group, &called, &otherPath]() {
+        group.load(otherPath);
+        called.push_back("load");
+    });
+    registry.add("count", [&called]() {
+        called.push_back("count");
+    });
+    group.load(path);
+
+    context.processEvent(keyEvent(SDL_KEYDOWN, 'a', 0));
+    context.processEvent(keyEvent(SDL_KEYUP, 'a', 1));
+    context.processEvent(keyEvent(SDL_KEYDOWN, 'a', 2));
+
+    std::remove(textPath.c_str());
+    std::remove(path.c_str());
+    std::remove(otherPath.c_str());
+
+    const std::vector<std::string> expected = {"self", "load", "replaced", "count"};
+    if (called != expected) {
+        std::string names;
+        for (const auto& name : called) {
+            names += " " + name;
+        }
+        fprintf(stderr, "replace_from_callbacks: called%s instead of self load replaced count!\n", names.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static Uint64 tableCounter = 0;
+
+static void countTableCallback() {
+    tableCounter++;
+}
+
+template <SDL_Keycode... Keys>
+using TableBinding = Trigger::Binding<countTableCallback, Keys...>;
+
+// the same bindings as a static table and as a dynamic group
+using StaticTable = Trigger::StaticGroup<
+    TableBinding<'a'>, TableBinding<'b'>, TableBinding<'c', 'd'>, TableBinding<'e', 'f'>,
+    TableBinding<'g', 'h'>, TableBinding<'i', 'j', 'k'>, TableBinding<'l', 'm'>, TableBinding<'n'>,
+    TableBinding<'o', 'p'>, TableBinding<'q', 'r'>, TableBinding<'s', 't', 'u'>, TableBinding<'v', 'w'>,
+    TableBinding<'x'>, TableBinding<'y', 'z'>, TableBinding<'0', '1'>, TableBinding<'2', '3', '4'>
+>;
+
+static const std::vector<Trigger::Keycodes> TABLE_KEYS = {
+    {'a'}, {'b'}, {'c', 'd'}, {'e', 'f'},
+    {'g', 'h'}, {'i', 'j', 'k'}, {'l', 'm'}, {'n'},
+    {'o', 'p'}, {'q', 'r'}, {'s', 't', 'u'}, {'v', 'w'},
+    {'x'}, {'y', 'z'}, {'0', '1'}, {'2', '3', '4'}
+};
+
+// both have to call the callbacks exactly as often
+static bool compareStaticTable(size_t eventCount) {
+    std::mt19937 random(8765);
+    const std::vector<SDL_Event> events = generateEvents(eventCount, random);
+
+    Uint64 counts[2];
+    for (int isStatic = 0; isStatic < 2; isStatic++) {
+        Workload workload = {isStatic ? "static_table" : "dynamic_table", TABLE_KEYS.size(), 2, 1, 1.0, eventCount, COMBINATIONS};
+
+        std::unique_ptr<StaticTable> table;
+        std::unique_ptr<Trigger::Group> group;
+        if (isStatic) {
+            table.reset(new StaticTable());
+        } else {
+            group.reset(new Trigger::Group());
+            for (const auto& keys : TABLE_KEYS) {
+                group->on(keys, countTableCallback);
+            }
+        }
+
+        Trigger::keyboard.reset();
+        Trigger::processEvents(events);
+        tableCounter = 0;
+
+        const Uint64 start = SDL_GetPerformanceCounter();
+        Trigger::processEvents(events);
+        const double seconds = double(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+        Result result;
+        result.nsPerEvent = seconds * 1e9 / events.size();
+        result.allocationsPerEvent = 0;
+        result.callbacks = tableCounter;
+        result.callbacksPerSecond = seconds > 0 ? tableCounter / seconds : 0;
+        report(workload, result);
+
+        counts[isStatic] = tableCounter;
+    }
+
+    if (counts[0] != counts[1]) {
+        fprintf(stderr, "static_table: %llu callbacks instead of %llu!\n", (unsigned long long)counts[1], (unsigned long long)counts[0]);
+        return false;
+    }
+
+    return true;
+}
+
+// in deferred mode a reset or a disable drops the queued callbacks of the
+// group, a static one like a dynamic one
+template <typename G>
+static bool dropQueued(G& group, const char* name) {
+    bool isCorrect = true;
+
+    for (int operation = 0; operation < 3; operation++) {
+        Trigger::keyboard.reset();
+        tableCounter = 0;
+
+        Trigger::processEvent(keyEvent(SDL_KEYDOWN, 'a', 0));
+        Trigger::processEvent(keyEvent(SDL_KEYUP, 'a', 0));
+        if (operation == 1) {
+            group.reset();
+        } else if (operation == 2) {
+            group.disable();
+        }
+        Trigger::dispatchPending();
+        group.enable();
+
+        const Uint64 expected = operation == 0 ? 1 : 0;
+        if (tableCounter != expected) {
+            fprintf(stderr, "%s: %llu queued callbacks called after %s, %llu expected!\n", name, (unsigned long long)tableCounter,
+                    operation == 0 ? "nothing" : operation == 1 ? "a reset" : "a disable", (unsigned long long)expected);
+            isCorrect = false;
+        }
+    }
+
+    return isCorrect;
+}
+
+static bool dropQueuedTable() {
+    Trigger::setDeferred(true);
+
+    bool isStaticCorrect = false;
+    {
+        StaticTable table;
+        isStaticCorrect = dropQueued(table, "drop_queued_static");
+    }
+
+    bool isDynamicCorrect = false;
+    {
+        Trigger::Group group;
+        for (const auto& keys : TABLE_KEYS) {
+            group.on(keys, countTableCallback);
+        }
+        isDynamicCorrect = dropQueued(group, "drop_queued_dynamic");
+    }
+
+    Trigger::setDeferred(false);
+    Trigger::keyboard.reset();
+
+    return isStaticCorrect && isDynamicCorrect;
+}
+
+// records a stream into a capture, then replays the mapped capture
+static bool replayCapture(size_t eventCount, const std::string& path) {
+    Workload workload = {"replay", 1000, 2, 1, 1.0, eventCount, COMBINATIONS};
+
+    std::mt19937 random(5678);
+    const std::vector<SDL_Event> events = generateEvents(workload.events, random);
+
+    Uint64 counter = 0;
+    std::vector<std::unique_ptr<Trigger::Group>> groups;
+    bind(groups, workload, counter, random);
+
+    Trigger::keyboard.reset();
+    {
+        Trigger::Recorder recorder(path);
+        recorder.start();
+        Trigger::processEvents(events);
+    }
+    const Uint64 expected = counter;
+
+    counter = 0;
+    groups[0]->reset();
+    Trigger::keyboard.reset();
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+
+    Trigger::Replayer replayer(path);
+    replayer.run();
+
+    const double seconds = double(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    Result result;
+    result.nsPerEvent = seconds * 1e9 / replayer.eventCount();
+    result.allocationsPerEvent = 0;
+    result.callbacks = counter;
+    result.callbacksPerSecond = seconds > 0 ? counter / seconds : 0;
+    report(workload, result);
+
+    std::remove(path.c_str());
+
+    if (counter != expected) {
+        fprintf(stderr, "replay: %llu callbacks instead of %llu!\n", (unsigned long long)counter, (unsigned long long)expected);
+        return false;
+    }
+
+    return true;
+}
+
+// a replayed callback destroying a group and unbinding a binding, both
+// with their callbacks queued for the same keypress, only it is called
+static bool replayUnbinding(const std::string& path) {
+    Trigger::keyboard.reset();
+    {
+        Trigger::Recorder recorder(path);
+        recorder.start();
+        Trigger::processEvent(keyEvent(SDL_KEYDOWN, 'a', 0));
+        Trigger::processEvent(keyEvent(SDL_KEYUP, 'a', 1));
+    }
+    Trigger::keyboard.reset();
+
+    size_t called = 0;
+    std::unique_ptr<Trigger::Group> destroyed(new Trigger::Group());
+    destroyed->on('a', [&called]() {
+        called++;
+    });
+
+    Trigger::Group group;
+    group.setPriority(1);
+    Trigger::Handle unbound = {0, 0};
+    group.on('a', [&]() {
+        destroyed.reset();
+        group.off(unbound);
+        called++;
+    });
+    unbound = group.on('a', [&called]() {
+        called++;
+    });
+
+    Trigger::Replayer replayer(path);
+    const Uint64 replayed = replayer.run();
+    const auto fireCounts = replayer.fireCounts();
+
+    std::remove(path.c_str());
+
+    if (called != 1 || replayed != 1 || fireCounts.size() != 1 || fireCounts[0].trigger != 0 || fireCounts[0].count != 1) {
+        fprintf(stderr, "replay_unbinding: %zu callbacks called, %llu replayed and %zu fired instead of one!\n",
+                called, (unsigned long long)replayed, fireCounts.size());
+        return false;
+    }
+
+    return true;
+}
+
+// callbacks binding keys in their own group, enough of them to grow its
+// storage while they run, inline and in deferred mode
+static bool defineFromCallbacks() {
+    static const size_t DEFINED = 1000;
+    bool isCorrect = true;
+
+    for (int isDeferred = 0; isDeferred < 2; isDeferred++) {
+        Trigger::setDeferred(isDeferred);
+        Trigger::keyboard.reset();
+
+        Trigger::Group group;
+        size_t defined = 0;
+        size_t called = 0;
+
+        group.on('a', [&group, &defined, &called]() {
+            for (size_t i = 0; i < DEFINED; i++) {
+                group.on('b', [&called]() {
+                    called++;
+                });
+            }
+
+            // the captures are read after the group grew
+            defined += DEFINED;
+        });
+
+        for (SDL_Keycode key : {'a', 'b'}) {
+            Trigger::processEvent(keyEvent(SDL_KEYDOWN, key, 0));
+            Trigger::processEvent(keyEvent(SDL_KEYUP, key, 0));
+            Trigger::dispatchPending();
+        }
+
+        if (defined != DEFINED || called != DEFINED) {
+            fprintf(stderr, "%s: %zu bindings defined by callbacks and %zu of them called, %zu expected!\n",
+                    isDeferred ? "define_deferred" : "define_inline", defined, called, DEFINED);
+            isCorrect = false;
+        }
+    }
+
+    Trigger::setDeferred(false);
+    Trigger::keyboard.reset();
+
+    return isCorrect;
+}
+
+// a callback destroying an earlier group, moving its own one down and
+// creating one on top while a keypress walks the groups, each group sees
+// it once, the changed order holds from the next keypress
+static bool reorderFromCallbacks() {
+    Trigger::keyboard.reset();
+
+    std::string order;
+    std::unique_ptr<Trigger::Group> first(new Trigger::Group());
+    std::unique_ptr<Trigger::Group> created;
+    Trigger::Group second;
+    Trigger::Group third;
+    first->setPriority(3);
+    second.setPriority(2);
+    third.setPriority(1);
+
+    first->on('a', [&order]() {
+        order += '1';
+    });
+    second.on('a', [&]() {
+        order += '2';
+        if (created == nullptr) {
+            first.reset();
+            second.setPriority(0);
+            created.reset(new Trigger::Group());
+            created->setPriority(5);
+            created->on('a', [&order]() {
+                order += 'c';
+            });
+        }
+    });
+    third.on('a', [&order]() {
+        order += '3';
+    });
+
+    for (int press = 0; press < 2; press++) {
+        Trigger::processEvent(keyEvent(SDL_KEYDOWN, 'a', 0));
+        Trigger::processEvent(keyEvent(SDL_KEYUP, 'a', 0));
+    }
+
+    Trigger::keyboard.reset();
+
+    if (order != "123c32") {
+        fprintf(stderr, "reorder_groups: the groups fired in the order %s instead of 123c32!\n", order.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// callbacks processing keypresses of their own group, the nested ones
+// match more bindings than the keypress, the release and the sequence
+// step walking the bindings they were called from, and they are another
+// key pressed since, so only the keypress still calls its next binding
+static bool processFromCallbacks() {
+    static const size_t NESTED = 100;
+    Trigger::keyboard.reset();
+
+    Trigger::Group group;
+    size_t nested = 0;
+    size_t called = 0;
+
+    for (size_t i = 0; i < NESTED; i++) {
+        group.on('b', [&nested]() {
+            nested++;
+        });
+    }
+
+    const auto nest = []() {
+        Trigger::processEvent(keyEvent(SDL_KEYDOWN, 'b', 0));
+        Trigger::processEvent(keyEvent(SDL_KEYUP, 'b', 0));
+    };
+    const auto count = [&called]() {
+        called++;
+    };
+
+    group.on('a', nest);
+    group.on('a', count);
+    group.onRelease({'r'}, nest);
+    group.onRelease({'r'}, count);
+    group.onSequence({{'x'}, {'y'}}, nest);
+    group.onSequence({{'x'}, {'y'}}, count);
+
+    for (SDL_Keycode key : {'a', 'r', 'x', 'y'}) {
+        Trigger::processEvent(keyEvent(SDL_KEYDOWN, key, 0));
+        Trigger::processEvent(keyEvent(SDL_KEYUP, key, 0));
+    }
+
+    Trigger::keyboard.reset();
+
+    if (nested != 3 * NESTED || called != 1) {
+        fprintf(stderr, "process_nested: %zu nested and %zu outer callbacks called, %zu and 1 expected!\n", nested, called, 3 * NESTED);
+        return false;
+    }
+
+    return true;
+}
+
+// a sequence unbound while it is in progress, the next one reuses its
+// pruned trie nodes and starts from the beginning, not from where it was
+static bool unbindSequences() {
+    Trigger::keyboard.reset();
+
+    Trigger::Group group;
+    size_t called = 0;
+    const auto count = [&called]() {
+        called++;
+    };
+
+    const Trigger::Handle unbound = group.onSequence({{'x'}, {'y'}}, count);
+    Trigger::processEvent(keyEvent(SDL_KEYDOWN, 'x', 0));
+    Trigger::processEvent(keyEvent(SDL_KEYUP, 'x', 0));
+    group.off(unbound);
+
+    group.onSequence({{'z'}, {'w'}}, count);
+    Uint32 now = 1;
+    for (SDL_Keycode key : {'w', 'z', 'w'}) {
+        Trigger::processEvent(keyEvent(SDL_KEYDOWN, key, now));
+        Trigger::processEvent(keyEvent(SDL_KEYUP, key, now++));
+    }
+
+    Trigger::keyboard.reset();
+
+    if (called != 1) {
+        fprintf(stderr, "unbind_sequences: %zu sequences fired instead of 1!\n", called);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char const *argv[])
+{
+    size_t eventCount = 200000;
+    bool isVerifying = false; // only the correctness checks, without the workloads
+
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+
+        if (argument == "-o" && i + 1 < argc) {
+            output = fopen(argv[++i], "w");
+            if (output == NULL) {
+                fprintf(stderr, "Could not open %s!\n", argv[i]);
+                return 1;
+            }
+        } else if (argument == "-n" && i + 1 < argc) {
+            eventCount = std::strtoul(argv[++i], NULL, 10);
+        } else if (argument == "--verify") {
+            isVerifying = true;
+        } else {
+            fprintf(stderr, "usage: %s [-o results.jsonl] [-n events] [--verify]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // no window is ever created, but the scancode groups translate keycodes
+    // with the keymap of the video subsystem, be safe on machines without display
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_EVENTS) != 0) {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return 1;
+    }
+
+    std::vector<Workload> workloads;
+
+    for (size_t bindings : {10, 100, 1000, 10000, 100000}) {
+        workloads.push_back({"bindings", bindings, 2, 1, 1.0, eventCount, COMBINATIONS});
+    }
+
+    // the packed keys against the dispatch index, every keypress scans all
+    // of the packed ones, so they stop at 10000 bindings
+    for (auto evaluation : {Trigger::Group::INDEXED, Trigger::Group::PACKED_SCALAR, Trigger::Group::PACKED}) {
+        for (size_t bindings : {10, 30, 100, 300, 1000, 10000}) {
+            workloads.push_back({"evaluation", bindings, 2, 1, 1.0, eventCount, COMBINATIONS, false, false, Trigger::Group::BY_KEYCODE, 0, evaluation});
+        }
+    }
+
+    for (size_t keys : {1, 2, 3, 4, 6}) {
+        workloads.push_back({"combination_length", 10000, keys, 1, 1.0, eventCount, COMBINATIONS});
+    }
+
+    for (size_t groups : {1, 10, 100, 1000}) {
+        workloads.push_back({"groups", 10000, 2, groups, 1.0, eventCount, COMBINATIONS});
+    }
+
+    for (size_t groups : {1, 10, 100, 1000}) {
+        workloads.push_back({"consuming_groups", 10000, 1, groups, 1.0, eventCount, COMBINATIONS, true});
+    }
+
+    for (size_t bindings : {10, 1000, 100000}) {
+        workloads.push_back({"toggled_groups", bindings, 2, 10, 1.0, eventCount, COMBINATIONS, false, true});
+    }
+
+    for (auto matching : {Trigger::Group::BY_KEYCODE, Trigger::Group::BY_SCANCODE}) {
+        const char* name = matching == Trigger::Group::BY_KEYCODE ? "keycode_matching" : "scancode_matching";
+        for (size_t bindings : {100, 1000, 10000}) {
+            workloads.push_back({name, bindings, 2, 1, 1.0, eventCount, COMBINATIONS, false, false, matching});
+        }
+    }
+
+    for (double ratio : {1.0, 0.5, 0.1}) {
+        workloads.push_back({"enabled_ratio", 10000, 2, 100, ratio, eventCount, COMBINATIONS});
+    }
+
+    for (size_t sequences : {10, 1000, 50000}) {
+        workloads.push_back({"sequences", sequences, 1, 1, 1.0, eventCount, SEQUENCES});
+    }
+
+    for (size_t holds : {10, 1000, 50000}) {
+        workloads.push_back({"hold_timers", holds, 1, 1, 1.0, eventCount, HOLDS});
+    }
+
+    if (!isVerifying) {
+        for (const auto& workload : workloads) {
+            report(workload, measure(workload));
+        }
+    }
+
+    const bool isPipelineCorrect = stressPipeline(eventCount) && stopFullPipeline();
+    const bool isReplayCorrect = replayCapture(eventCount, "bench_capture.bin") && replayUnbinding("bench_capture.bin");
+    const bool isStaticTableCorrect = compareStaticTable(eventCount) && dropQueuedTable();
+    const bool areContextsCorrect = scaleContexts(eventCount);
+    const bool isKeymapCorrect = loadKeymap(eventCount, "bench_keymap.bin") && replaceFromCallbacks("bench_keymap.bin");
+    const bool areCallbacksSafe = defineFromCallbacks() && reorderFromCallbacks() && processFromCallbacks();
+    const bool areSequencesCorrect = unbindSequences();
+
+    if (output != stdout) {
+        fclose(output);
+    }
+
+    SDL_Quit();
+
+    return isPipelineCorrect && isReplayCorrect && isStaticTableCorrect && areContextsCorrect && isKeymapCorrect && areCallbacksSafe && areSequencesCorrect ? 0 : 1;
+}
@@ -50,19 +50,19 @@ int main(int argc, char const *argv[])
 
     Trigger::Group moveControls;
 
-    moveControls.on(SDLK_UP, []() {
+    Trigger::Handle moveUp = moveControls.onRepeat({SDLK_UP}, 150, []() {
         Maze.moveUp();
     });
 
-    moveControls.on(SDLK_RIGHT, []() {
+    Trigger::Handle moveRight = moveControls.onRepeat({SDLK_RIGHT}, 150, []() {
         Maze.moveRight();
     });
 
-    moveControls.on(SDLK_DOWN, []() {
+    Trigger::Handle moveDown = moveControls.onRepeat({SDLK_DOWN}, 150, []() {
         Maze.moveDown();
     });
 
-    moveControls.on(SDLK_LEFT, []() {
+    Trigger::Handle moveLeft = moveControls.onRepeat({SDLK_LEFT}, 150, []() {
         Maze.moveLeft();
     });
 
@@ -71,11 +71,11 @@ int main(int argc, char const *argv[])
 
     Trigger::Group mazeManipulations;
 
-    mazeManipulations.on({SDLK_LCTRL, SDLK_LSHIFT, SDLK_r}, []() {
+    Trigger::Handle randomizeMap = mazeManipulations.on({SDLK_LCTRL, SDLK_LSHIFT, SDLK_r}, []() {
         Maze.generate();
     });
 
-    mazeManipulations.on({SDLK_LCTRL, SDLK_RSHIFT, SDLK_c}, []() {
+    Trigger::Handle dropCoin = mazeManipulations.on({SDLK_LCTRL, SDLK_RSHIFT, SDLK_c}, []() {
         Maze.drop(Maze_t::Tile::COIN);
     });
 
@@ -84,30 +84,44 @@ int main(int argc, char const *argv[])
 
     // GLOBAL KEYBINDINGS
 
-    Trigger::on(SDLK_SPACE, [&mazeManipulations]() {
+    Trigger::Handle toggleAdvanced = Trigger::on(SDLK_SPACE, [&mazeManipulations]() {
         mazeManipulations.toggle();
     });
 
-    Trigger::on(SDLK_q, [&running]() {
+    // rebinding keeps the handles, so the buttons follow the new keys
+    static const SDL_Keycode ARROWS[] = {SDLK_UP, SDLK_RIGHT, SDLK_DOWN, SDLK_LEFT};
+    static const SDL_Keycode WASD[] = {SDLK_w, SDLK_d, SDLK_s, SDLK_a};
+    const Trigger::Handle moves[] = {moveUp, moveRight, moveDown, moveLeft};
+    bool isWasd = false;
+
+    Trigger::Handle swapMoveKeys = Trigger::on(SDLK_TAB, [&moveControls, &moves, &isWasd]() {
+        isWasd = !isWasd;
+        for (size_t i = 0; i < 4; i++) {
+            moveControls.rebind(moves[i], {isWasd ? WASD[i] : ARROWS[i]});
+        }
+    });
+
+    Trigger::Handle closeDemo = Trigger::on(SDLK_q, [&running]() {
         running = false;
     });
 
-    Trigger::on(SDLK_ESCAPE, [&running]() {
+    Trigger::Handle alsoCloseDemo = Trigger::on(SDLK_ESCAPE, [&running]() {
         running = false;
     });
 
-    combinations.push_back(Combination("Move Up", {SDLK_UP}));
-    combinations.push_back(Combination("Move Right", {SDLK_RIGHT}));
-    combinations.push_back(Combination("Move Down", {SDLK_DOWN}));
-    combinations.push_back(Combination("Move Left", {SDLK_LEFT}));
+    combinations.push_back(Combination("Move Up", moveControls, moveUp));
+    combinations.push_back(Combination("Move Right", moveControls, moveRight));
+    combinations.push_back(Combination("Move Down", moveControls, moveDown));
+    combinations.push_back(Combination("Move Left", moveControls, moveLeft));
 
-    combinations.push_back(Combination("Toggle Advanced", {SDLK_SPACE}));
+    combinations.push_back(Combination("Toggle Advanced", Trigger::globalGroup, toggleAdvanced));
+    combinations.push_back(Combination("Arrows / WASD", Trigger::globalGroup, swapMoveKeys));
 
-    combinations.push_back(Combination("Randomize Map", {SDLK_LCTRL, SDLK_LSHIFT, SDLK_r}));
-    combinations.push_back(Combination("Drop Coin", {SDLK_LCTRL, SDLK_RSHIFT, SDLK_c}));
+    combinations.push_back(Combination("Randomize Map", mazeManipulations, randomizeMap));
+    combinations.push_back(Combination("Drop Coin", mazeManipulations, dropCoin));
 
-    combinations.push_back(Combination("Close This Demo", {SDLK_q}));
-    combinations.push_back(Combination("Also Close This Demo", {SDLK_ESCAPE}));
+    combinations.push_back(Combination("Close This Demo", Trigger::globalGroup, closeDemo));
+    combinations.push_back(Combination("Also Close This Demo", Trigger::globalGroup, alsoCloseDemo));
 
     Maze.generate();
 
@@ -136,6 +150,9 @@ int main(int argc, char const *argv[])
             }
         }
 
+        // keeps moving while an arrow key is held, even without new events
+        Trigger::tick(SDL_GetTicks());
+
         KeyPressLog::autoScroll();
 
         SDL_FillRect(surface, NULL, Surface::colorFor(0, 0, 0));
@@ -147,31 +164,22 @@ int main(int argc, char const *argv[])
             recordY -= 20;
 
             Uint8 color = 100 / KeyPressLog::maxRecords * (KeyPressLog::maxRecords - i);
-            SDL_Surface* recordSurface = Surface::ofText(record.c_str(), {color, color, color});
-
-            SDL_Rect recordRect;
-            recordRect.x = 10;
-            recordRect.y = recordY;
-
-            SDL_BlitSurface(recordSurface, NULL, surface, &recordRect);
-            SDL_FreeSurface(recordSurface);
+            Surface::drawText(surface, record.c_str(), 10, recordY, {color, color, color});
 
             i++;
         }
 
-        SDL_Surface *clockSurface = Surface::ofText(currentTime().c_str());
+        SDL_Surface *clockSurface = Surface::ofCachedText(currentTime());
         SDL_Rect clockRect;
         clockRect.x = WIDTH - clockSurface->w - 10;
         clockRect.y = 10;
         SDL_BlitSurface(clockSurface, NULL, surface, &clockRect);
-        SDL_FreeSurface(clockSurface);
 
-        SDL_Surface *githubSurface = Surface::ofText("https://github.com/Semmu/SDL_Trigger");
+        SDL_Surface *githubSurface = Surface::ofCachedText("https://github.com/Semmu/SDL_Trigger");
         SDL_Rect githubRect;
         githubRect.x = WIDTH - githubSurface->w - 10;
         githubRect.y = HEIGHT - githubSurface->h - 10;
         SDL_BlitSurface(githubSurface, NULL, surface, &githubRect);
-        SDL_FreeSurface(githubSurface);
 
         SDL_Surface* mazeSurface = Maze.render();
         SDL_Rect mazeRect;
@@ -179,12 +187,11 @@ int main(int argc, char const *argv[])
         mazeRect.x = WIDTH - mazeSurface->w - 30;
         SDL_BlitSurface(mazeSurface, NULL, surface, &mazeRect);
 
-        SDL_Surface* levelSurface = Surface::ofText((std::string("Level #") + std::to_string(Maze.level) + std::string(" - Coins: ") + std::to_string(Maze.coinsCollected)).c_str());
+        SDL_Surface* levelSurface = Surface::ofCachedText(std::string("Level #") + std::to_string(Maze.level) + std::string(" - Coins: ") + std::to_string(Maze.coinsCollected));
         SDL_Rect levelRect;
         levelRect.x = mazeRect.x + + (mazeSurface->w - levelSurface->w) / 2;
         levelRect.y = mazeRect.y - 20;
         SDL_BlitSurface(levelSurface, NULL, surface, &levelRect);
-        SDL_FreeSurface(levelSurface);
 
         SDL_Rect combinationRect;
         combinationRect.x = 10;
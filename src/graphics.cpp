@@ -2,52 +2,32 @@
 #include "graphics.h"
 #include "util.h"
 
-Button::Button(std::vector<SDL_Keycode> keys, size_t index) : keys{keys}, index{index} {
-    //
-}
-
-Button Button::forCombinationKey(std::vector<SDL_Keycode> keys, size_t index) {
+Button::Button(const Trigger::Group& group, Trigger::Handle handle, size_t index) : group{&group}, handle{handle}, index{index}, key{SDLK_UNKNOWN}, isEnabled{false}, isDown{false}, isDirty{true} {
 
-    if (!(index < keys.size())) {
+    if (!(index < group.keyCount(handle))) {
         throw std::runtime_error("Key combination index too big while creating Button!");
     }
-
-    Button button(keys, index);
-
-    button.findKeyState();
-
-    return button;
 }
 
 void Button::findKeyState() {
-    for(auto& group : Trigger::groups) {
-        for(auto& trigger : group->triggers) {
-            if (trigger.combination.keys.size() == keys.size()) {
-                bool matches = true;
-                for (size_t i = 0; i < keys.size(); i++) {
-                    if (trigger.combination.keys[i].key != keys[i]) {
-                        matches = false;
-                    }
-                }
-
-                if (matches) {
-                    keyState = &trigger.combination.keys[index];
-                    isEnabled = group->isEnabled;
-                    return;
-                }
-            }
-        }
-    }
-
-    throw std::runtime_error("Button couldn't find corresponding key combination in Trigger::triggers!");
+    const SDL_Keycode wasKey = key;
+    const bool wasDown = isDown;
+    const bool wasEnabled = isEnabled;
+
+    key = index < group->keyCount(handle) ? group->keyOf(handle, index) : SDLK_UNKNOWN;
+    isDown = group->isKeyDown(handle, index);
+    isEnabled = group->isEnabled;
+    isDirty = isDirty || key != wasKey || isDown != wasDown || isEnabled != wasEnabled;
 }
 
 SDL_Surface* Button::render() {
 
-    findKeyState();
+    if (!isDirty) {
+        return surface;
+    }
 
     SDL_Color labelColor = isEnabled ? SDL_Color{90, 120, 50} : SDL_Color{90, 90, 90};
-    SDL_Surface* labelSurface = Surface::ofText(SDL_GetKeyName(keyState->key), labelColor);
+    SDL_Surface* labelSurface = Surface::ofCachedText(SDL_GetKeyName(key), labelColor);
     if (labelSurface == NULL) {
         throw std::runtime_error("Could not render label!");
     }
@@ -55,16 +35,23 @@ SDL_Surface* Button::render() {
     const int surfaceWitdh = labelSurface->w + 2 * BUTTON_PADDING;
     const int surfaceHeight = labelSurface->h + 2 * BUTTON_PADDING + BUTTON_HEIGHT;
 
-    SDL_FreeSurface(surface);
-    surface = Surface::create(labelSurface->w + 2 * BUTTON_PADDING,
-                              labelSurface->h + 2 * BUTTON_PADDING + BUTTON_HEIGHT);
+    // the surface is reused, unless a rebound key has a label of another size
+    if (surface != NULL && (surface->w != surfaceWitdh || surface->h != surfaceHeight)) {
+        free();
+    }
+
+    if (surface == NULL) {
+        surface = Surface::create(surfaceWitdh, surfaceHeight);
+    } else {
+        SDL_FillRect(surface, NULL, Surface::COLOR_TRANSPARENT);
+    }
 
     int facingSideColor = isEnabled ? Surface::colorFor(120, 150, 70) : Surface::colorFor(100, 100, 100);
     SDL_Rect facingSideRect;
     facingSideRect.w = surfaceWitdh;
     facingSideRect.h = surfaceHeight;
     facingSideRect.x = 0;
-    facingSideRect.y = (keyState->isDown ? BUTTON_DEPTH : 0);
+    facingSideRect.y = (isDown ? BUTTON_DEPTH : 0);
     SDL_FillRect(surface, &facingSideRect, facingSideColor);
 
     int outlineColor = isEnabled ? Surface::colorFor(230, 250, 180) : Surface::colorFor(180, 180, 180);
@@ -72,48 +59,99 @@ SDL_Surface* Button::render() {
     outlineRect.w = surfaceWitdh - 2;
     outlineRect.h = labelSurface->h + 2 * BUTTON_PADDING - 2;
     outlineRect.x = 1;
-    outlineRect.y = (keyState->isDown ? BUTTON_DEPTH : 0) + 1;
+    outlineRect.y = (isDown ? BUTTON_DEPTH : 0) + 1;
     SDL_FillRect(surface, &outlineRect, outlineColor);
 
-    int topColor = isEnabled ? (keyState->isDown ? outlineColor : Surface::colorFor(170, 210, 100)) : Surface::colorFor(150, 150, 150);
+    int topColor = isEnabled ? (isDown ? outlineColor : Surface::colorFor(170, 210, 100)) : Surface::colorFor(150, 150, 150);
     SDL_Rect topRect;
     topRect.w = surfaceWitdh - 4;
     topRect.h = surfaceHeight - BUTTON_HEIGHT - 4;
     topRect.x = 2;
-    topRect.y = (keyState->isDown ? BUTTON_DEPTH : 0) + 2;
+    topRect.y = (isDown ? BUTTON_DEPTH : 0) + 2;
     SDL_FillRect(surface, &topRect, topColor);
 
     SDL_Rect labelRect;
     labelRect.x = BUTTON_PADDING;
-    labelRect.y = BUTTON_PADDING + (keyState->isDown ? BUTTON_DEPTH : 0);
+    labelRect.y = BUTTON_PADDING + (isDown ? BUTTON_DEPTH : 0);
     SDL_BlitSurface(labelSurface, NULL, surface, &labelRect);
-    SDL_FreeSurface(labelSurface);
 
+    isDirty = false;
     return surface;
 }
 
+void Button::free() {
+    SDL_FreeSurface(surface);
+    surface = NULL;
+}
+
 std::vector<Combination> combinations;
 
-Combination::Combination(std::string description, std::vector<SDL_Keycode> keys) : description{description}, buttons{}, surface{NULL} {
-    for (size_t i = 0; i < keys.size(); i++) {
-        buttons.push_back(Button(keys, i));
+Combination::Combination(std::string description, const Trigger::Group& group, Trigger::Handle handle) : description{description}, group{&group}, handle{handle}, buttons{}, surface{NULL}, checkedChanges{0} {
+    if (!group.isBound(handle)) {
+        throw std::runtime_error("Combination of an unbound handle!");
+    }
+
+    createButtons();
+}
+
+void Combination::createButtons() {
+    for (auto& button : buttons) {
+        button.free();
+    }
+    buttons.clear();
+
+    for (size_t i = 0; i < group->keyCount(handle); i++) {
+        buttons.push_back(Button(*group, handle, i));
     }
 }
 
 SDL_Surface* Combination::render() {
-    SDL_Surface *descriptionSurface = Surface::ofText(description.c_str());
-    for(size_t i = 0; i < buttons.size(); i++) {
-        buttons[i].render();
+    // nothing changed in the engine since the last check
+    if (surface != NULL && checkedChanges == Trigger::changeCount()) {
+        return surface;
+    }
+    checkedChanges = Trigger::changeCount();
+
+    // rebound to another number of keys, or unbound
+    bool isDirty = surface == NULL;
+    if (buttons.size() != group->keyCount(handle)) {
+        createButtons();
+        isDirty = true;
+    }
+
+    for (auto& button : buttons) {
+        button.findKeyState();
+        isDirty = isDirty || button.isDirty;
+    }
+
+    if (!isDirty) {
+        return surface;
     }
 
-    int height = buttons[0].surface->h;
+    for (auto& button : buttons) {
+        button.render();
+    }
+
+    SDL_Surface *descriptionSurface = Surface::ofCachedText(description);
+
     int width = DESCRIPTION_WIDTH + BUTTON_DISTANCE;
+    int height = descriptionSurface->h;
     for (auto& button : buttons) {
         width += button.surface->w + BUTTON_DISTANCE;
+        height = button.surface->h;
     }
 
-    SDL_FreeSurface(surface);
-    surface = Surface::create(width, height);
+    // the size changes only with the keys
+    if (surface != NULL && (surface->w != width || surface->h != height)) {
+        SDL_FreeSurface(surface);
+        surface = NULL;
+    }
+
+    if (surface == NULL) {
+        surface = Surface::create(width, height);
+    } else {
+        SDL_FillRect(surface, NULL, Surface::COLOR_TRANSPARENT);
+    }
 
     SDL_Rect descriptionRect;
     descriptionRect.x = (DESCRIPTION_WIDTH - descriptionSurface->w) - BUTTON_DISTANCE;
@@ -127,10 +165,9 @@ SDL_Surface* Combination::render() {
         buttonRect.w = button.surface->w;
         buttonRect.h = button.surface->h;
 
-        SDL_BlitSurface(button.render(), NULL, surface, &buttonRect);
+        SDL_BlitSurface(button.surface, NULL, surface, &buttonRect);
         buttonRect.x += button.surface->w + BUTTON_DISTANCE;
     }
 
-    SDL_FreeSurface(descriptionSurface);
     return surface;
 }
@@ -1,78 +1,500 @@
 #include "sdl_trigger.h"
 #include <iostream>
 #include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef SDL_TRIGGER_STATS
+#define SDL_TRIGGER_COUNT(counter) (counter).add(1)
+#define SDL_TRIGGER_STATS_LOCK(context) std::lock_guard<std::mutex> statsLock((context).statsMutex)
+#else
+#define SDL_TRIGGER_COUNT(counter)
+#define SDL_TRIGGER_STATS_LOCK(context)
+#endif
+
+// the packed scans are compiled for SSE2 and AVX2 on x86 and picked at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SDL_TRIGGER_PACKED_X86
+#include <immintrin.h>
+#endif
 
 namespace Trigger {
 
-    std::vector<Group*> groups;
-    Group globalGroup;
+    Context& defaultContext() {
+        static Context context;
+        return context;
+    }
 
-    bool KeyCombination::hasKey(SDL_Keycode key) const {
-        for(size_t i = 0; i < keys.size(); i++) {
-            if (keys[i].key == key) {
-                return true;
+    KeyboardState& keyboard = defaultContext().keyboard;
+    TimerWheel& timers = defaultContext().timers;
+    Group& globalGroup = defaultContext().globalGroup;
+    std::vector<Group*>& groups = defaultContext().groups;
+    std::recursive_mutex& groupsMutex = defaultContext().groupsMutex;
+
+    // the triggers of a packed group with code in one of their slots, in
+    // trigger order, the stride is a multiple of PACKED_LANES
+    using PackedScan = size_t (*)(const SDL_Keycode* codes, const Sint32* counts, size_t width, size_t stride, SDL_Keycode code, Group::KeySlots* hits);
+
+    static size_t scanPackedScalar(const SDL_Keycode* codes, const Sint32* counts, size_t, size_t stride, SDL_Keycode code, Group::KeySlots* hits) {
+        size_t found = 0;
+        for (size_t trigger = 0; trigger < stride; trigger++) {
+            Uint32 slots = 0;
+            for (Sint32 slot = 0; slot < counts[trigger]; slot++) {
+                if (codes[slot * stride + trigger] == code) {
+                    slots |= Uint32{1} << slot;
+                }
+            }
+
+            if (slots != 0) {
+                hits[found++] = {trigger, slots};
             }
         }
+        return found;
+    }
 
-        return false;
+#ifdef SDL_TRIGGER_PACKED_X86
+    // every lane ORs in the bit of the slots equal to the code, the slots
+    // past its key count are masked out by comparing it to the slot
+    __attribute__((target("sse2")))
+    static size_t scanPackedSse2(const SDL_Keycode* codes, const Sint32* counts, size_t width, size_t stride, SDL_Keycode code, Group::KeySlots* hits) {
+        const __m128i wanted = _mm_set1_epi32(code);
+        const __m128i zero = _mm_setzero_si128();
+        alignas(16) Uint32 lanes[4];
+
+        size_t found = 0;
+        for (size_t first = 0; first < stride; first += 4) {
+            const __m128i keyCounts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + first));
+            __m128i slots = zero;
+
+            for (size_t slot = 0; slot < width; slot++) {
+                const __m128i column = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + slot * stride + first));
+                const __m128i isBound = _mm_cmpgt_epi32(keyCounts, _mm_set1_epi32(static_cast<int>(slot)));
+                const __m128i matches = _mm_and_si128(_mm_cmpeq_epi32(column, wanted), isBound);
+                slots = _mm_or_si128(slots, _mm_and_si128(matches, _mm_set1_epi32(static_cast<int>(Uint32{1} << slot))));
+            }
+
+            int mask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(slots, zero))) & 0xF;
+            if (mask != 0) {
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), slots);
+                for (; mask != 0; mask &= mask - 1) {
+                    const int lane = __builtin_ctz(mask);
+                    hits[found++] = {first + lane, lanes[lane]};
+                }
+            }
+        }
+        return found;
     }
 
-    void KeyCombination::markKeyDown(SDL_Keycode key) {
-        for(size_t i = 0; i < keys.size(); i++) {
-            if (keys[i].key == key) {
-                keys[i].isDown = true;
+    __attribute__((target("avx2")))
+    static size_t scanPackedAvx2(const SDL_Keycode* codes, const Sint32* counts, size_t width, size_t stride, SDL_Keycode code, Group::KeySlots* hits) {
+        const __m256i wanted = _mm256_set1_epi32(code);
+        const __m256i zero = _mm256_setzero_si256();
+        alignas(32) Uint32 lanes[8];
+
+        size_t found = 0;
+        for (size_t first = 0; first < stride; first += 8) {
+            const __m256i keyCounts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(counts + first));
+            __m256i slots = zero;
+
+            for (size_t slot = 0; slot < width; slot++) {
+                const __m256i column = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + slot * stride + first));
+                const __m256i isBound = _mm256_cmpgt_epi32(keyCounts, _mm256_set1_epi32(static_cast<int>(slot)));
+                const __m256i matches = _mm256_and_si256(_mm256_cmpeq_epi32(column, wanted), isBound);
+                slots = _mm256_or_si256(slots, _mm256_and_si256(matches, _mm256_set1_epi32(static_cast<int>(Uint32{1} << slot))));
+            }
+
+            int mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(slots, zero))) & 0xFF;
+            if (mask != 0) {
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), slots);
+                for (; mask != 0; mask &= mask - 1) {
+                    const int lane = __builtin_ctz(mask);
+                    hits[found++] = {first + lane, lanes[lane]};
+                }
             }
         }
+        return found;
     }
+#endif
 
-    void KeyCombination::markKeyUp(SDL_Keycode key) {
-        for(size_t i = 0; i < keys.size(); i++) {
-            if (keys[i].key == key) {
-                keys[i].isDown = false;
+    // the CPU is asked once
+    static PackedScan packedScan() {
+        static const PackedScan scan = []() -> PackedScan {
+#ifdef SDL_TRIGGER_PACKED_X86
+            if (SDL_HasAVX2()) {
+                return &scanPackedAvx2;
+            }
+            if (SDL_HasSSE2()) {
+                return &scanPackedSse2;
             }
+#endif
+            return &scanPackedScalar;
+        }();
+        return scan;
+    }
+
+    const char* packedInstructions() {
+#ifdef SDL_TRIGGER_PACKED_X86
+        if (packedScan() == &scanPackedAvx2) {
+            return "avx2";
         }
+        if (packedScan() == &scanPackedSse2) {
+            return "sse2";
+        }
+#endif
+        return "scalar";
     }
 
-    void KeyCombination::reset() {
-        for(size_t i = 0; i < keys.size(); i++) {
-            keys[i].isDown = false;
+    KeyboardState::KeyboardState() {
+        reset();
+    }
+
+    void KeyboardState::processEvent(const SDL_Event& e) {
+        const SDL_Keycode key = e.key.keysym.sym;
+        const SDL_Scancode scancode = e.key.keysym.scancode;
+
+        if (e.type == SDL_KEYDOWN) {
+            if (e.key.repeat == 0) {
+                presses++;
+            }
+
+            if (scancode < SDL_NUM_SCANCODES) {
+                scancodes[scancode] = 1;
+            }
+
+            if (!isKeyDown(key) && heldCount < MAX_HELD_KEYS) {
+                heldKeys[heldCount] = key;
+                heldScancodes[heldCount] = scancode;
+                heldCount++;
+            }
+        } else if (e.type == SDL_KEYUP) {
+            if (scancode < SDL_NUM_SCANCODES) {
+                scancodes[scancode] = 0;
+            }
+
+            for (size_t i = 0; i < heldCount; i++) {
+                if (heldKeys[i] == key) {
+                    heldCount--;
+                    heldKeys[i] = heldKeys[heldCount];
+                    heldScancodes[i] = heldScancodes[heldCount];
+                    break;
+                }
+            }
+        }
+    }
+
+    void KeyboardState::reset() {
+        presses = 0;
+        std::fill(scancodes, scancodes + SDL_NUM_SCANCODES, 0);
+        heldCount = 0;
+    }
+
+    bool KeyboardState::isKeyDown(SDL_Keycode key) const {
+        for (size_t i = 0; i < heldCount; i++) {
+            if (heldKeys[i] == key) {
+                return true;
+            }
         }
+
+        return false;
+    }
+
+    bool KeyboardState::isScancodeDown(SDL_Scancode scancode) const {
+        return scancode < SDL_NUM_SCANCODES && scancodes[scancode] != 0;
+    }
+
+    KeyCombination::KeyCombination(size_t firstKey, size_t keyCount) : firstKey{static_cast<Uint32>(firstKey)}, keyCount{static_cast<Uint32>(keyCount)}, downMask{0} {
+        if (keyCount > MAX_KEYS) {
+            throw std::runtime_error("Too many keys in a single key combination!");
+        }
+
+        fulfilledMask = keyCount == MAX_KEYS ? ~Uint32{0} : (Uint32{1} << keyCount) - 1;
+    }
+
+    void KeyCombination::markKeysDown(Uint32 slots) {
+        downMask |= slots;
+    }
+
+    void KeyCombination::markKeysUp(Uint32 slots) {
+        downMask &= ~slots;
+    }
+
+    void KeyCombination::reset() {
+        downMask = 0;
     }
 
     bool KeyCombination::isFulfilled() const {
-        for(size_t i = 0; i < keys.size(); i++) {
-            if (!keys[i].isDown) {
-                return false;
+        return downMask == fulfilledMask;
+    }
+
+    bool KeyCombination::isKeyDown(size_t slot) const {
+        return (downMask >> slot) & 1;
+    }
+
+    static size_t hashKeys(const SDL_Keycode* keys, size_t count) {
+        size_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < count; i++) {
+            hash = (hash ^ static_cast<Uint32>(keys[i])) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    size_t KeycodesHash::operator()(const Keycodes& keys) const {
+        return hashKeys(keys.data(), keys.size());
+    }
+
+    static const SDL_Keycode* codesOf(const Group& group, const Group::KeySpan& span) {
+        return span.codes != NULL ? span.codes : group.keys.data() + group.triggers[span.trigger].combination.firstKey;
+    }
+
+    size_t Group::KeySpanHash::operator()(const KeySpan& span) const {
+        return hashKeys(codesOf(*group, span), span.count);
+    }
+
+    bool Group::KeySpanEqual::operator()(const KeySpan& a, const KeySpan& b) const {
+        return a.count == b.count && std::equal(codesOf(*group, a), codesOf(*group, a) + a.count, codesOf(*group, b));
+    }
+
+    Trigger::Trigger(KeyCombination combination, Kind kind, Uint32 interval) : combination{combination}, kind{kind}, lastPress{0}, epoch{0}, interval{interval}, sequenceEnd{0}, timerGeneration{0}, modifiers{0}, anySideModifiers{0},
+                     generation{1}, keyCapacity{combination.keyCount}, isFree{false} {
+        //
+    }
+
+#ifdef SDL_TRIGGER_STATS
+    void TriggerStats::reset() {
+        evaluations.reset();
+        partialMatches.reset();
+        resets.reset();
+        fires.reset();
+        callbackTicks.reset();
+        maxCallbackTicks.reset();
+    }
+#endif
+
+    // the right side bit of every modifier follows the left side one
+    static const Uint16 LEFT_MODIFIERS = KMOD_LSHIFT | KMOD_LCTRL | KMOD_LALT | KMOD_LGUI;
+    static const Uint16 RIGHT_MODIFIERS = LEFT_MODIFIERS << 1;
+
+    bool Trigger::matchesModifiers(Uint16 mod) const {
+        // a held side of a side-agnostic modifier counts as both sides
+        const Uint16 held = mod & (LEFT_MODIFIERS | RIGHT_MODIFIERS);
+        const Uint16 bothSides = held | (held & LEFT_MODIFIERS) << 1 | (held & RIGHT_MODIFIERS) >> 1;
+        return ((held & ~anySideModifiers) | (bothSides & anySideModifiers)) == modifiers;
+    }
+
+    TimerWheel::TimerWheel() : due{}, cascading{}, levelCounts{}, now{0}, count{0}, isStarted{false}, isAdvancing{false} {
+        //
+    }
+
+    void TimerWheel::schedule(const Timer& timer) {
+        Timer scheduled = timer;
+
+        // the current millisecond is already expired
+        if (static_cast<Sint32>(scheduled.deadline - now) <= 0) {
+            scheduled.deadline = now + 1;
+        }
+
+        count++;
+        place(scheduled);
+    }
+
+    void TimerWheel::place(const Timer& timer) {
+        const Uint32 delta = timer.deadline - now;
+
+        size_t level = 0;
+        while (level + 1 < LEVELS && delta >> (SLOT_BITS * (level + 1)) != 0) {
+            level++;
+        }
+
+        // further than the wheel reaches, parked in its last slot and
+        // placed again when that slot comes up
+        Uint32 position = timer.deadline;
+        if (delta >> (SLOT_BITS * LEVELS) != 0) {
+            position = now + (Uint32{1} << (SLOT_BITS * LEVELS)) - 1;
+        }
+
+        slots[level][(position >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(timer);
+        levelCounts[level]++;
+    }
+
+    void TimerWheel::advance(Uint32 to) {
+        // time never goes backwards, and expiring callbacks may process events
+        if (isAdvancing || (isStarted && static_cast<Sint32>(to - now) <= 0)) {
+            return;
+        }
+
+        isStarted = true;
+        isAdvancing = true;
+
+        while (now != to) {
+            if (count == 0) {
+                now = to;
+                break;
+            }
+
+            // nothing happens until the next slot of the lowest used level comes up
+            size_t emptyLevels = 0;
+            while (levelCounts[emptyLevels] == 0) {
+                emptyLevels++;
+            }
+
+            if (emptyLevels > 0) {
+                const Uint32 skipped = now | ((Uint32{1} << (SLOT_BITS * emptyLevels)) - 1);
+                if (static_cast<Sint32>(to - skipped) <= 0) {
+                    now = to;
+                    break;
+                }
+                now = skipped;
+            }
+
+            now++;
+
+            // the timers of a higher level slot move down when it comes up
+            for (size_t level = LEVELS - 1; level > 0; level--) {
+                if ((now & ((Uint32{1} << (SLOT_BITS * level)) - 1)) == 0) {
+                    cascading.swap(slots[level][(now >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+                    levelCounts[level] -= cascading.size();
+                    for (const auto& timer : cascading) {
+                        place(timer);
+                    }
+                    cascading.clear();
+                }
             }
+
+            due.swap(slots[0][now & (SLOTS - 1)]);
+            levelCounts[0] -= due.size();
+            count -= due.size();
+
+            // callbacks may destroy groups, so the list is walked by index
+            for (size_t i = 0; i < due.size(); i++) {
+                if (due[i].group != NULL) {
+                    due[i].group->expire(due[i]);
+                }
+            }
+            due.clear();
         }
 
-        return true;
+        isAdvancing = false;
+    }
+
+    void TimerWheel::cancel(const Group* group) {
+        for (size_t level = 0; level < LEVELS; level++) {
+            for (auto& slot : slots[level]) {
+                const size_t before = slot.size();
+                slot.erase(std::remove_if(slot.begin(), slot.end(), [group](const Timer& timer) {
+                    return timer.group == group;
+                }), slot.end());
+
+                levelCounts[level] -= before - slot.size();
+                count -= before - slot.size();
+            }
+        }
+
+        for (auto& timer : due) {
+            if (timer.group == group) {
+                timer.group = NULL;
+            }
+        }
+    }
+
+    void TimerWheel::reset() {
+        for (auto& level : slots) {
+            for (auto& slot : level) {
+                slot.clear();
+            }
+        }
+
+        std::fill(levelCounts, levelCounts + LEVELS, 0);
+        count = 0;
+        isStarted = false;
+    }
+
+    size_t TimerWheel::size() const {
+        return count;
+    }
+
+    // after the groups of the same priority, once no event walks them
+    static void placeByPriority(Group* group) {
+        auto& context = group->context;
+        if (context.walkDepth > 0) {
+            context.placedAfterWalk.push_back(group);
+            return;
+        }
+
+        SDL_TRIGGER_STATS_LOCK(context);
+        auto& groups = context.groups;
+        groups.erase(std::remove(groups.begin(), groups.end(), group), groups.end());
+
+        const auto position = std::upper_bound(groups.begin(), groups.end(), group, [](const Group* a, const Group* b) {
+            return a->priority > b->priority;
+        });
+        groups.insert(position, group);
     }
 
-    Trigger::Trigger(Keycodes keys, Callback callback) : callback{callback} {
-        for(const auto key : keys) {
-            combination.keys.push_back({key, false});
+    static void placeAfterWalk(Context& context) {
+        if (context.hasDestroyedWhileWalking) {
+            SDL_TRIGGER_STATS_LOCK(context);
+            context.groups.erase(std::remove(context.groups.begin(), context.groups.end(), static_cast<Group*>(NULL)), context.groups.end());
+            context.hasDestroyedWhileWalking = false;
+        }
+
+        // one by one, so the same priorities keep the order they got it in
+        for (size_t i = 0; i < context.placedAfterWalk.size(); i++) {
+            placeByPriority(context.placedAfterWalk[i]);
         }
+        context.placedAfterWalk.clear();
+    }
+
+    Group::Group(Matching matching) : Group(defaultContext(), matching) {
+        //
     }
 
-    Group::Group() : triggers{}, isEnabled{true} {
-        groups.push_back(this);
+    Group::Group(Context& context, Matching matching) : context(context), matching{matching}, triggers{}, keys{}, callbacks{}, isEnabled{true}, epoch{0}, priority{0}, isConsuming{false}, hasFulfilled{false}, keyIndex{},
+                     scancodeIndex(matching == BY_SCANCODE ? SDL_NUM_SCANCODES : 0), entryPositions{}, triggersByKeys(0, KeySpanHash{this}, KeySpanEqual{this}), keylessTriggers{}, freeTriggers{}, unboundTriggers{}, firingDepth{0}, matchingDepth{0}, candidates{}, hasReleaseTriggers{false},
+                     evaluation{INDEXED}, packedCodes{}, packedCounts{}, packedWidth{0}, packedStride{0}, packedHits{},
+                     chords{}, chordIds{}, sequenceNodes{}, freeSequenceNodes{}, sequenceEdges{}, sequenceNode{0}, sequenceEpoch{0}, sequenceStepTime{0}, sequenceTimeout{DEFAULT_SEQUENCE_TIMEOUT}, heldChord{} {
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+        placeByPriority(this);
     }
 
     Group::~Group() {
-        groups.erase(std::remove(groups.begin(), groups.end(), this));
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+
+        auto& groups = context.groups;
+        if (context.walkDepth > 0) {
+            SDL_TRIGGER_STATS_LOCK(context);
+            std::replace(groups.begin(), groups.end(), this, static_cast<Group*>(NULL));
+            context.hasDestroyedWhileWalking = true;
+        } else {
+            SDL_TRIGGER_STATS_LOCK(context);
+            groups.erase(std::remove(groups.begin(), groups.end(), this), groups.end());
+        }
+        context.placedAfterWalk.erase(std::remove(context.placedAfterWalk.begin(), context.placedAfterWalk.end(), this), context.placedAfterWalk.end());
+
+        context.changes++;
+        context.timers.cancel(this);
+        dropPending();
+    }
+
+    void Group::dropPending() {
+        context.pendingCallbacks.erase(std::remove_if(context.pendingCallbacks.begin(), context.pendingCallbacks.end(), [this](const PendingCallback& pending) {
+            return pending.group == this;
+        }), context.pendingCallbacks.end());
+
+        for (auto& dispatched : context.dispatchedCallbacks) {
+            if (dispatched.group == this) {
+                dispatched.group = NULL;
+            }
+        }
     }
 
     void Group::enable() {
         isEnabled = true;
+        context.changes++;
     }
 
     void Group::disable() {
+        reset();
         isEnabled = false;
-
-        for (auto& trigger : triggers) {
-            trigger.combination.reset();
-        }
     }
 
     void Group::toggle() {
@@ -83,54 +505,1314 @@ namespace Trigger {
         }
     }
 
-    void Group::on(SDL_Keycode key, Callback callback) {
-        on(Keycodes{key}, callback);
+    void Group::setPriority(int priority) {
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+
+        this->priority = priority;
+        placeByPriority(this);
     }
 
-    void Group::on(Keycodes keys, Callback callback) {
-        triggers.push_back(Trigger(keys, callback));
+    void Group::setConsuming(bool isConsuming) {
+        this->isConsuming = isConsuming;
     }
 
-    void Group::processEvent(SDL_Event& e) {
-        SDL_Keycode key = e.key.keysym.sym;
+    void Group::setEvaluation(Evaluation evaluation) {
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
 
-        if (e.type == SDL_KEYDOWN && e.key.repeat == 0) {
-            for (auto& trigger : triggers) {
-                if (trigger.combination.hasKey(key)) {
-                    trigger.combination.markKeyDown(key);
-                } else {
-                    trigger.combination.reset();
+        this->evaluation = evaluation;
+        if (evaluation == INDEXED) {
+            packedCodes = std::vector<SDL_Keycode>();
+            packedCounts = std::vector<Sint32>();
+            packedHits = std::vector<KeySlots>();
+            packedWidth = 0;
+            packedStride = 0;
+        } else {
+            pack();
+        }
+    }
+
+    Handle Group::on(SDL_Keycode key, Callback callback) {
+        return on(&key, 1, std::move(callback));
+    }
+
+    Handle Group::on(std::initializer_list<SDL_Keycode> keys, Callback callback) {
+        return on(keys.begin(), keys.size(), std::move(callback));
+    }
+
+    Handle Group::on(const Keycodes& keys, Callback callback) {
+        return on(keys.data(), keys.size(), std::move(callback));
+    }
+
+    Handle Group::on(const SDL_Keycode* keys, size_t count, Callback callback) {
+        return add(keys, count, std::move(callback), Trigger::PRESS, 0);
+    }
+
+    Handle Group::onScancode(SDL_Scancode scancode, Callback callback) {
+        return onScancode(&scancode, 1, std::move(callback));
+    }
+
+    Handle Group::onScancode(std::initializer_list<SDL_Scancode> scancodes, Callback callback) {
+        return onScancode(scancodes.begin(), scancodes.size(), std::move(callback));
+    }
+
+    Handle Group::onScancode(const SDL_Scancode* scancodes, size_t count, Callback callback) {
+        if (count > KeyCombination::MAX_KEYS) {
+            throw std::runtime_error("Too many keys in a single key combination!");
+        }
+
+        // a keycode group matches the key at that position in the current layout
+        SDL_Keycode codes[KeyCombination::MAX_KEYS];
+        for (size_t i = 0; i < count; i++) {
+            codes[i] = matching == BY_SCANCODE ? static_cast<SDL_Keycode>(scancodes[i]) : SDL_GetKeyFromScancode(scancodes[i]);
+        }
+
+        return addCodes(codes, count, std::move(callback), Trigger::PRESS, 0);
+    }
+
+    Handle Group::onModified(Uint16 modifiers, SDL_Keycode key, Callback callback) {
+        const Handle handle = add(&key, 1, std::move(callback), Trigger::MODIFIED, 0);
+
+        // the lock keys are ignored, they are not held
+        auto& trigger = triggers[handle.index];
+        trigger.modifiers = modifiers & (LEFT_MODIFIERS | RIGHT_MODIFIERS);
+        const Uint16 pairs = trigger.modifiers & (trigger.modifiers >> 1) & LEFT_MODIFIERS;
+        trigger.anySideModifiers = pairs | pairs << 1;
+
+        return handle;
+    }
+
+    Handle Group::onHold(std::initializer_list<SDL_Keycode> keys, Uint32 milliseconds, Callback callback) {
+        return add(keys.begin(), keys.size(), std::move(callback), Trigger::HOLD, milliseconds);
+    }
+
+    Handle Group::onHold(const Keycodes& keys, Uint32 milliseconds, Callback callback) {
+        return add(keys.data(), keys.size(), std::move(callback), Trigger::HOLD, milliseconds);
+    }
+
+    Handle Group::onRepeat(std::initializer_list<SDL_Keycode> keys, Uint32 interval, Callback callback) {
+        return add(keys.begin(), keys.size(), std::move(callback), Trigger::REPEAT, interval);
+    }
+
+    Handle Group::onRepeat(const Keycodes& keys, Uint32 interval, Callback callback) {
+        return add(keys.data(), keys.size(), std::move(callback), Trigger::REPEAT, interval);
+    }
+
+    Handle Group::onRelease(std::initializer_list<SDL_Keycode> keys, Callback callback) {
+        return add(keys.begin(), keys.size(), std::move(callback), Trigger::RELEASE, 0);
+    }
+
+    Handle Group::onRelease(const Keycodes& keys, Callback callback) {
+        return add(keys.data(), keys.size(), std::move(callback), Trigger::RELEASE, 0);
+    }
+
+    Handle Group::add(const SDL_Keycode* keys, size_t count, Callback callback, Trigger::Kind kind, Uint32 interval) {
+        // too many keys are rejected by validate
+        if (matching == BY_KEYCODE || count > KeyCombination::MAX_KEYS) {
+            return addCodes(keys, count, std::move(callback), kind, interval);
+        }
+
+        SDL_Keycode codes[KeyCombination::MAX_KEYS];
+        translate(keys, count, codes);
+
+        return addCodes(codes, count, std::move(callback), kind, interval);
+    }
+
+    Handle Group::addCodes(const SDL_Keycode* codes, size_t count, Callback callback, Trigger::Kind kind, Uint32 interval) {
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+
+        validate(codes, count, kind, interval);
+
+        const size_t index = allocate(std::move(callback), kind, interval);
+        bindKeys(index, codes, count);
+        context.changes++;
+
+        if (kind == Trigger::RELEASE) {
+            hasReleaseTriggers = true;
+        }
+
+        return handleOf(index);
+    }
+
+    void Group::translate(const SDL_Keycode* keys, size_t count, SDL_Keycode* codes) const {
+        for (size_t i = 0; i < count; i++) {
+            codes[i] = codeOf(keys[i]);
+        }
+    }
+
+    void Group::validate(const SDL_Keycode* codes, size_t count, Trigger::Kind kind, Uint32 interval) const {
+        if (count > KeyCombination::MAX_KEYS) {
+            throw std::runtime_error("Too many keys in a single key combination!");
+        }
+
+        if (kind != Trigger::PRESS && count == 0) {
+            throw std::runtime_error("Hold, repeat and release triggers need keys!");
+        }
+
+        if (kind == Trigger::MODIFIED && count != 1) {
+            throw std::runtime_error("Modified triggers take a single key!");
+        }
+
+        if ((kind == Trigger::HOLD || kind == Trigger::REPEAT) && interval == 0) {
+            throw std::runtime_error("Hold and repeat intervals must be at least 1 millisecond!");
+        }
+
+        if (matching == BY_SCANCODE) {
+            for (size_t slot = 0; slot < count; slot++) {
+                if (codes[slot] <= SDL_SCANCODE_UNKNOWN || codes[slot] >= SDL_NUM_SCANCODES) {
+                    throw std::runtime_error("Invalid scancode!");
                 }
             }
+        }
+    }
+
+    size_t Group::allocate(Callback&& callback, Trigger::Kind kind, Uint32 interval) {
+        SDL_TRIGGER_STATS_LOCK(context);
+
+        if (freeTriggers.empty()) {
+            triggers.push_back(Trigger(KeyCombination(keys.size(), 0), kind, interval));
+            callbacks.push_back(std::move(callback));
+            return triggers.size() - 1;
+        }
+
+        const size_t index = freeTriggers.back();
+        freeTriggers.pop_back();
+
+        // the generations go on, so the handles and the timers of the
+        // previous binding of the slot stay stale
+        auto& trigger = triggers[index];
+        callbacks[index] = std::move(callback);
+        trigger.kind = kind;
+        trigger.lastPress = 0;
+        trigger.interval = interval;
+        trigger.modifiers = 0;
+        trigger.anySideModifiers = 0;
+        trigger.isFree = false;
+#ifdef SDL_TRIGGER_STATS
+        trigger.stats.reset();
+#endif
 
-            for (auto& trigger : triggers) {
-                if (trigger.combination.isFulfilled()) {
-                    trigger.callback();
+        return index;
+    }
+
+    void Group::bindKeys(size_t index, const SDL_Keycode* codes, size_t count) {
+        SDL_TRIGGER_STATS_LOCK(context);
+        auto& trigger = triggers[index];
+
+        // the key slots it already owns are reused if they are enough
+        size_t firstKey = trigger.combination.firstKey;
+        if (count > trigger.keyCapacity) {
+            firstKey = keys.size();
+            keys.insert(keys.end(), codes, codes + count);
+            entryPositions.resize(keys.size());
+            trigger.keyCapacity = count;
+        } else {
+            std::copy(codes, codes + count, keys.begin() + firstKey);
+        }
+        trigger.combination = KeyCombination(firstKey, count);
+
+        if (count == 0) {
+            keylessTriggers.insert(std::lower_bound(keylessTriggers.begin(), keylessTriggers.end(), index), index);
+        }
+
+        // appended, a key repeated in the combination has a single entry,
+        // the one appended last, and every slot knows where it is
+        for (size_t slot = 0; slot < count; slot++) {
+            auto& list = matching == BY_SCANCODE ? scancodeIndex[codes[slot]] : keyIndex[codes[slot]];
+            auto& entries = list.entries;
+            if (entries.empty() || entries.back().trigger != index) {
+                if (!entries.empty() && entries.back().trigger > index) {
+                    list.isUnsorted = true;
                 }
+                entries.push_back({index, 0});
             }
-        } else if (e.type == SDL_KEYUP) {
-            for (auto& trigger : triggers) {
-                if (trigger.combination.hasKey(key)) {
-                    trigger.combination.markKeyUp(key);
-                }
+            entries.back().slots |= Uint32{1} << slot;
+            entryPositions[firstKey + slot] = entries.size() - 1;
+        }
+
+        if (count > 0) {
+            const auto bound = triggersByKeys.insert({index, NULL, count});
+            if (!bound.second && bound.first->trigger > index) {
+                bound.first->trigger = index;
             }
         }
-    }
 
-    void on(SDL_Keycode key, Callback callback) {
-        on(Keycodes{key}, callback);
+        // the columns are repacked only if they are too short or too few
+        if (evaluation != INDEXED) {
+            if (index >= packedStride || count > packedWidth) {
+                pack();
+            } else {
+                packTrigger(index);
+            }
+        }
     }
 
-    void on(Keycodes keys, Callback callback) {
-        globalGroup.triggers.push_back(Trigger(keys, callback));
+    void Group::unbindKeys(size_t index) {
+        auto& trigger = triggers[index];
+        const SDL_Keycode* codes = keys.data() + trigger.combination.firstKey;
+        const size_t count = trigger.combination.keyCount;
+
+        if (count == 0) {
+            keylessTriggers.erase(std::lower_bound(keylessTriggers.begin(), keylessTriggers.end(), index));
+        }
+
+        // a key repeated in the combination has a single entry, removed
+        // with its first slot, the other slots find another trigger there
+        for (size_t slot = 0; slot < count; slot++) {
+            KeyEntries* list = findKeyEntries(codes[slot]);
+            const size_t position = entryPositions[trigger.combination.firstKey + slot];
+            if (list == NULL || position >= list->entries.size() || list->entries[position].trigger != index) {
+                continue;
+            }
+
+            removeKeyEntry(*list, position);
+            if (list->entries.empty() && matching == BY_KEYCODE) {
+                keyIndex.erase(codes[slot]);
+            }
+        }
+
+        if (count > 0) {
+            const auto found = triggersByKeys.find({index, NULL, count});
+            if (found != triggersByKeys.end() && found->trigger == index) {
+                // the lowest other slot bound to the same keys is found instead
+                bool isShared = false;
+                const KeyEntries* sharing = findKeyEntries(codes[0]);
+                if (sharing != NULL) {
+                    for (const auto& entry : sharing->entries) {
+                        const auto& other = triggers[entry.trigger];
+                        if ((!isShared || entry.trigger < found->trigger) && other.combination.keyCount == count &&
+                            std::equal(codes, codes + count, keys.begin() + other.combination.firstKey)) {
+                            found->trigger = entry.trigger;
+                            isShared = true;
+                        }
+                    }
+                }
+
+                if (!isShared) {
+                    triggersByKeys.erase(found);
+                }
+            }
+        }
+
+        if (evaluation != INDEXED) {
+            packedCounts[index] = 0;
+        }
+
+        // its keypresses and its timers are forgotten
+        trigger.combination.reset();
+        trigger.lastPress = 0;
+        trigger.timerGeneration++;
     }
 
-    void processEvent(SDL_Event& e) {
-        for (auto& group : groups) {
-            if (group->isEnabled) {
-                group->processEvent(e);
+    void Group::placeKeyEntry(const KeySlots& entry, size_t position) {
+        const auto& combination = triggers[entry.trigger].combination;
+        for (size_t slot = 0; slot < combination.keyCount; slot++) {
+            if ((entry.slots >> slot) & 1) {
+                entryPositions[combination.firstKey + slot] = position;
             }
         }
     }
 
+    void Group::removeKeyEntry(KeyEntries& list, size_t position) {
+        auto& entries = list.entries;
+        if (position + 1 != entries.size()) {
+            entries[position] = entries.back();
+            placeKeyEntry(entries[position], position);
+            list.isUnsorted = true;
+        }
+        entries.pop_back();
+
+        if (entries.empty()) {
+            list.isUnsorted = false;
+        }
+    }
+
+    void Group::freeTrigger(size_t index) {
+        SDL_TRIGGER_STATS_LOCK(context);
+        auto& trigger = triggers[index];
+        trigger.isFree = true;
+        trigger.generation = trigger.generation + 1 == 0 ? 1 : trigger.generation + 1;
+
+        // a callback being called is destroyed after it returns
+        if (firingDepth > 0) {
+            unboundTriggers.push_back(index);
+        } else {
+            callbacks[index] = Callback();
+            freeTriggers.push_back(index);
+        }
+    }
+
+    void Group::pack() {
+        // the lanes at least double, so binding one by one stays amortized O(1)
+        const size_t lanes = (triggers.size() + PACKED_LANES - 1) / PACKED_LANES * PACKED_LANES;
+        if (lanes > packedStride) {
+            packedStride = std::max(lanes, packedStride * 2);
+        }
+
+        packedWidth = 0;
+        for (const auto& trigger : triggers) {
+            if (!trigger.isFree && trigger.combination.keyCount > packedWidth) {
+                packedWidth = trigger.combination.keyCount;
+            }
+        }
+
+        packedCodes.assign(packedWidth * packedStride, 0);
+        packedCounts.assign(packedStride, 0);
+        packedHits.resize(packedStride);
+
+        for (size_t index = 0; index < triggers.size(); index++) {
+            if (!triggers[index].isFree) {
+                packTrigger(index);
+            }
+        }
+    }
+
+    void Group::packTrigger(size_t index) {
+        const auto& combination = triggers[index].combination;
+        for (size_t slot = 0; slot < combination.keyCount; slot++) {
+            packedCodes[slot * packedStride + index] = keys[combination.firstKey + slot];
+        }
+        packedCounts[index] = combination.keyCount;
+    }
+
+    size_t Group::scanPacked(SDL_Keycode code) {
+        const PackedScan scan = evaluation == PACKED ? packedScan() : &scanPackedScalar;
+        return scan(packedCodes.data(), packedCounts.data(), packedWidth, packedStride, code, packedHits.data());
+    }
+
+    bool Group::off(Handle handle) {
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+
+        if (!isBound(handle)) {
+            return false;
+        }
+
+        if (triggers[handle.index].kind == Trigger::SEQUENCE) {
+            // the trie nodes no other sequence needs are pruned, its chords
+            // stay for the sequences registered later
+            const Uint32 end = triggers[handle.index].sequenceEnd;
+            auto& ending = sequenceNodes[end].triggers;
+            ending.erase(std::find(ending.begin(), ending.end(), size_t{handle.index}));
+            triggers[handle.index].lastPress = 0;
+            pruneSequences(end);
+        } else {
+            unbindKeys(handle.index);
+        }
+
+        freeTrigger(handle.index);
+        context.changes++;
+
+        return true;
+    }
+
+    void Group::rebind(Handle handle, std::initializer_list<SDL_Keycode> keys) {
+        rebind(handle, keys.begin(), keys.size());
+    }
+
+    void Group::rebind(Handle handle, const Keycodes& keys) {
+        rebind(handle, keys.data(), keys.size());
+    }
+
+    void Group::rebind(Handle handle, const SDL_Keycode* keys, size_t count) {
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+
+        if (!isBound(handle)) {
+            throw std::runtime_error("Rebinding an unbound handle!");
+        }
+
+        const auto& trigger = triggers[handle.index];
+        if (trigger.kind == Trigger::SEQUENCE) {
+            throw std::runtime_error("Sequences can not be rebound!");
+        }
+
+        if (count > KeyCombination::MAX_KEYS) {
+            throw std::runtime_error("Too many keys in a single key combination!");
+        }
+
+        // checked before anything changes, so a rejected rebind keeps the old keys
+        SDL_Keycode codes[KeyCombination::MAX_KEYS];
+        translate(keys, count, codes);
+        validate(codes, count, trigger.kind, trigger.interval);
+
+        unbindKeys(handle.index);
+        bindKeys(handle.index, codes, count);
+        context.changes++;
+    }
+
+    Handle Group::onSequence(std::initializer_list<std::initializer_list<SDL_Keycode>> steps, Callback callback) {
+        std::vector<Keycodes> stepKeys;
+        for (const auto& step : steps) {
+            stepKeys.push_back(Keycodes(step));
+        }
+
+        return onSequence(stepKeys, std::move(callback));
+    }
+
+    Handle Group::onSequence(const std::vector<Keycodes>& steps, Callback callback) {
+        if (steps.empty()) {
+            throw std::runtime_error("Key sequence without steps!");
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+
+        // checked before the trie changes, so a rejected sequence leaves no nodes behind
+        std::vector<Keycodes> stepChords(steps.size());
+        for (size_t step = 0; step < steps.size(); step++) {
+            auto& chord = stepChords[step];
+            for (auto key : steps[step]) {
+                chord.push_back(codeOf(key));
+            }
+            std::sort(chord.begin(), chord.end());
+            chord.erase(std::unique(chord.begin(), chord.end()), chord.end());
+
+            if (chord.empty()) {
+                throw std::runtime_error("Key sequence with an empty step!");
+            }
+        }
+
+        if (sequenceNodes.empty()) {
+            sequenceNodes.push_back({{}, {}, 0, 0});
+        }
+
+        Uint32 node = 0;
+        for (const auto& chord : stepChords) {
+            auto found = chordIds.find(chord);
+            if (found == chordIds.end()) {
+                SDL_TRIGGER_STATS_LOCK(context);
+                chords.push_back(KeyCombination(keys.size(), chord.size()));
+                keys.insert(keys.end(), chord.begin(), chord.end());
+                found = chordIds.insert({chord, static_cast<Uint32>(chords.size() - 1)}).first;
+            }
+
+            const Uint64 edge = (Uint64{node} << 32) | found->second;
+            const auto next = sequenceEdges.find(edge);
+            if (next != sequenceEdges.end()) {
+                node = next->second;
+            } else {
+                sequenceNodes[node].chords.push_back(found->second);
+                Uint32 child = 0;
+                if (!freeSequenceNodes.empty()) {
+                    child = freeSequenceNodes.back();
+                    freeSequenceNodes.pop_back();
+                    sequenceNodes[child].parent = node;
+                    sequenceNodes[child].chord = found->second;
+                } else {
+                    sequenceNodes.push_back({{}, {}, node, found->second});
+                    child = sequenceNodes.size() - 1;
+                }
+                sequenceEdges[edge] = child;
+                node = child;
+            }
+        }
+
+        const size_t index = allocate(std::move(callback), Trigger::SEQUENCE, 0);
+        {
+            SDL_TRIGGER_STATS_LOCK(context);
+            triggers[index].combination = KeyCombination(triggers[index].combination.firstKey, 0);
+        }
+        triggers[index].sequenceEnd = node;
+        sequenceNodes[node].triggers.push_back(index);
+        context.changes++;
+
+        return handleOf(index);
+    }
+
+    void Group::setSequenceTimeout(Uint32 milliseconds) {
+        sequenceTimeout = milliseconds;
+    }
+
+    void Group::reserve(size_t triggerCount, size_t keyCount) {
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+
+        {
+            SDL_TRIGGER_STATS_LOCK(context);
+            triggers.reserve(triggerCount);
+            keys.reserve(keyCount);
+        }
+        entryPositions.reserve(keyCount);
+        if (matching == BY_KEYCODE) {
+            keyIndex.reserve(keyCount);
+        }
+        nextCandidates().reserve(triggerCount);
+    }
+
+    Handle Group::find(std::initializer_list<SDL_Keycode> keys) const {
+        return find(keys.begin(), keys.size());
+    }
+
+    Handle Group::find(const Keycodes& keys) const {
+        return find(keys.data(), keys.size());
+    }
+
+    Handle Group::find(const SDL_Keycode* keys, size_t count) const {
+        if (count > KeyCombination::MAX_KEYS) {
+            return Handle{0, 0};
+        }
+
+        SDL_Keycode codes[KeyCombination::MAX_KEYS];
+        for (size_t i = 0; i < count; i++) {
+            // a key without a scancode is bound in no scancode group
+            if (matching == BY_SCANCODE && SDL_GetScancodeFromKey(keys[i]) == SDL_SCANCODE_UNKNOWN) {
+                return Handle{0, 0};
+            }
+            codes[i] = codeOf(keys[i]);
+        }
+
+        const auto found = triggersByKeys.find({0, codes, count});
+        return found != triggersByKeys.end() ? handleOf(found->trigger) : Handle{0, 0};
+    }
+
+    bool Group::isBound(Handle handle) const {
+        return handle.isValid() && handle.index < triggers.size() && triggers[handle.index].generation == handle.generation;
+    }
+
+    size_t Group::keyCount(Handle handle) const {
+        return isBound(handle) ? triggers[handle.index].combination.keyCount : 0;
+    }
+
+    SDL_Keycode Group::keyOf(Handle handle, size_t slot) const {
+        if (slot >= keyCount(handle)) {
+            throw std::runtime_error("No such key in the binding!");
+        }
+
+        return keyOf(triggers[handle.index], slot);
+    }
+
+    bool Group::isKeyDown(Handle handle, size_t slot) const {
+        return slot < keyCount(handle) && isKeyDown(triggers[handle.index], slot);
+    }
+
+    Handle Group::handleOf(size_t index) const {
+        return Handle{static_cast<Uint32>(index), triggers[index].generation};
+    }
+
+    SDL_Keycode Group::keyOf(const Trigger& trigger, size_t slot) const {
+        const SDL_Keycode code = keys[trigger.combination.firstKey + slot];
+        return matching == BY_SCANCODE ? SDL_GetKeyFromScancode(static_cast<SDL_Scancode>(code)) : code;
+    }
+
+    SDL_Keycode Group::codeOf(SDL_Keycode key) const {
+        if (matching == BY_KEYCODE) {
+            return key;
+        }
+
+        const SDL_Scancode scancode = SDL_GetScancodeFromKey(key);
+        if (scancode == SDL_SCANCODE_UNKNOWN) {
+            throw std::runtime_error("No scancode for a key, is SDL initialized?");
+        }
+        return scancode;
+    }
+
+    SDL_Keycode Group::codeOf(const SDL_Keysym& keysym) const {
+        return matching == BY_SCANCODE ? static_cast<SDL_Keycode>(keysym.scancode) : keysym.sym;
+    }
+
+    bool Group::isCodeDown(SDL_Keycode code) const {
+        return matching == BY_SCANCODE ? context.keyboard.isScancodeDown(static_cast<SDL_Scancode>(code)) : context.keyboard.isKeyDown(code);
+    }
+
+    Group::KeyEntries* Group::findKeyEntries(SDL_Keycode code) {
+        if (matching == BY_SCANCODE) {
+            if (code < 0 || code >= static_cast<SDL_Keycode>(scancodeIndex.size()) || scancodeIndex[code].entries.empty()) {
+                return NULL;
+            }
+            return &scancodeIndex[code];
+        }
+
+        const auto found = keyIndex.find(code);
+        return found != keyIndex.end() ? &found->second : NULL;
+    }
+
+    const std::vector<Group::KeySlots>* Group::findKeySlots(SDL_Keycode code) {
+        KeyEntries* list = findKeyEntries(code);
+        if (list == NULL) {
+            return NULL;
+        }
+
+        // binding and unbinding leave them in any order, the callbacks are
+        // called in trigger order, so they are sorted once after the changes
+        if (list->isUnsorted) {
+            auto& entries = list->entries;
+            std::sort(entries.begin(), entries.end(), [](const KeySlots& a, const KeySlots& b) {
+                return a.trigger < b.trigger;
+            });
+            for (size_t position = 0; position < entries.size(); position++) {
+                placeKeyEntry(entries[position], position);
+            }
+            list->isUnsorted = false;
+        }
+
+        return &list->entries;
+    }
+
+    bool Group::isKeyDown(const Trigger& trigger, size_t slot) const {
+        // any keypress since the last one of the trigger reset its combination
+        return trigger.epoch == epoch && trigger.lastPress != 0 && trigger.lastPress == context.keyboard.presses &&
+               trigger.combination.isKeyDown(slot) && isCodeDown(keys[trigger.combination.firstKey + slot]);
+    }
+
+    bool Group::isFulfilled(const Trigger& trigger) const {
+        // a stale combination is reset, only an empty one is fulfilled then
+        if (trigger.epoch != epoch) {
+            return trigger.combination.keyCount == 0;
+        }
+
+        if (!trigger.combination.isFulfilled()) {
+            return false;
+        }
+
+        for (size_t slot = 0; slot < trigger.combination.keyCount; slot++) {
+            if (!isCodeDown(keys[trigger.combination.firstKey + slot])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void Group::reset() {
+        epoch++;
+        context.changes++;
+    }
+
+    void Group::fulfil(size_t index) {
+        SDL_TRIGGER_COUNT(triggers[index].stats.fires);
+        fulfil(index, triggers[index].generation);
+    }
+
+    void Group::fulfil(size_t index, Uint32 generation) {
+        hasFulfilled = true;
+        SDL_TRIGGER_COUNT(stats.fires);
+
+        if (context.deferred) {
+            context.pendingCallbacks.push_back({this, index, generation, epoch});
+        } else {
+            fire(index);
+        }
+    }
+
+    bool Group::isCurrent(size_t index, Uint32 generation) const {
+        return triggers[index].generation == generation;
+    }
+
+    void Group::startTimer(size_t index, Uint32 now) {
+        auto& trigger = triggers[index];
+        trigger.timerGeneration++;
+        context.timers.schedule({this, index, trigger.timerGeneration, now + trigger.interval});
+    }
+
+    void Group::expire(const TimerWheel::Timer& timer) {
+        // stale if the combination was fulfilled again, another key was
+        // pressed or one of its keys was released since it got scheduled
+        const auto& trigger = triggers[timer.trigger];
+        if (!isEnabled || trigger.timerGeneration != timer.generation || trigger.lastPress != context.keyboard.presses || !isFulfilled(trigger)) {
+            return;
+        }
+
+        const bool isRepeating = trigger.kind == Trigger::REPEAT;
+        const Uint32 interval = trigger.interval;
+
+        fulfil(timer.trigger);
+
+        // the next deadline follows the previous one, so the rate does not drift
+        if (isRepeating) {
+            context.timers.schedule({this, timer.trigger, timer.generation, timer.deadline + interval});
+        }
+    }
+
+    void Group::release(SDL_Keycode code) {
+        const auto found = findKeySlots(code);
+        if (found == NULL) {
+            return;
+        }
+
+        // the combination was fulfilled and no other key was pressed since,
+        // the released key is already missing from the keyboard state
+        auto& matched = nextCandidates();
+        matched.clear();
+        for (const auto& entry : *found) {
+            auto& trigger = triggers[entry.trigger];
+            if (trigger.kind != Trigger::RELEASE || trigger.epoch != epoch || trigger.lastPress != context.keyboard.presses || !trigger.combination.isFulfilled()) {
+                continue;
+            }
+
+            bool isHeld = true;
+            for (size_t slot = 0; slot < trigger.combination.keyCount && isHeld; slot++) {
+                const SDL_Keycode slotCode = keys[trigger.combination.firstKey + slot];
+                isHeld = slotCode == code || isCodeDown(slotCode);
+            }
+
+            if (isHeld) {
+                // fires once, until the combination is fulfilled again
+                trigger.combination.reset();
+                matched.push_back(entry.trigger);
+            }
+        }
+
+        matchingDepth++;
+        for (auto index : matched) {
+            // unless a callback unbound or rebound it meanwhile
+            if (triggers[index].lastPress == context.keyboard.presses) {
+                fulfil(index);
+            }
+        }
+        matchingDepth--;
+    }
+
+    void Group::advanceSequences(const SDL_Event& e) {
+        const Uint32 now = e.key.timestamp;
+        if (sequenceEpoch != epoch || (sequenceNode != 0 && now - sequenceStepTime > sequenceTimeout)) {
+            sequenceNode = 0;
+            sequenceEpoch = epoch;
+        }
+
+        if (matching == BY_SCANCODE) {
+            heldChord.assign(context.keyboard.heldScancodes, context.keyboard.heldScancodes + context.keyboard.heldCount);
+        } else {
+            heldChord.assign(context.keyboard.heldKeys, context.keyboard.heldKeys + context.keyboard.heldCount);
+        }
+        std::sort(heldChord.begin(), heldChord.end());
+
+        const auto chord = chordIds.find(heldChord);
+        if (chord != chordIds.end()) {
+            auto edge = sequenceEdges.find((Uint64{sequenceNode} << 32) | chord->second);
+
+            // a step that does not continue the sequence may start a new one
+            if (edge == sequenceEdges.end() && sequenceNode != 0) {
+                edge = sequenceEdges.find(chord->second);
+            }
+
+            if (edge != sequenceEdges.end()) {
+                const Uint32 node = edge->second;
+                sequenceNode = sequenceNodes[node].chords.empty() ? 0 : node;
+                sequenceStepTime = now;
+
+                // callbacks may register or unbind sequences, so they are
+                // copied and marked like the candidates of a keypress
+                auto& matched = nextCandidates();
+                matched.assign(sequenceNodes[node].triggers.begin(), sequenceNodes[node].triggers.end());
+                for (auto index : matched) {
+                    triggers[index].lastPress = context.keyboard.presses;
+                }
+
+                matchingDepth++;
+                for (auto index : matched) {
+                    if (triggers[index].lastPress == context.keyboard.presses) {
+                        fulfil(index);
+                    }
+                }
+                matchingDepth--;
+                return;
+            }
+        }
+
+        // any other keypress aborts the sequence, unless the held keys
+        // may still become the next step (eg. Ctrl pressed again)
+        if (sequenceNode != 0 && !isChordPrefix(sequenceNode)) {
+            sequenceNode = 0;
+        }
+    }
+
+    bool Group::isChordPrefix(Uint32 node) const {
+        for (const auto chord : sequenceNodes[node].chords) {
+            const auto first = keys.begin() + chords[chord].firstKey;
+            const auto last = first + chords[chord].keyCount;
+
+            if (std::includes(first, last, heldChord.begin(), heldChord.end())) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Group::pruneSequences(Uint32 node) {
+        while (node != 0 && sequenceNodes[node].triggers.empty() && sequenceNodes[node].chords.empty()) {
+            const Uint32 parent = sequenceNodes[node].parent;
+            const Uint32 chord = sequenceNodes[node].chord;
+
+            auto& siblings = sequenceNodes[parent].chords;
+            siblings.erase(std::find(siblings.begin(), siblings.end(), chord));
+            sequenceEdges.erase((Uint64{parent} << 32) | chord);
+            freeSequenceNodes.push_back(node);
+
+            // a sequence in progress can not continue from it, it may be reused for another one
+            if (sequenceNode == node) {
+                sequenceNode = 0;
+            }
+            node = parent;
+        }
+    }
+
+    std::vector<size_t>& Group::nextCandidates() {
+        // deeper lists are appended without moving the ones being walked
+        while (candidates.size() <= matchingDepth) {
+            candidates.emplace_back(new std::vector<size_t>());
+        }
+
+        return *candidates[matchingDepth];
+    }
+
+    void Group::fire(size_t index) {
+        firingDepth++;
+
+#ifdef SDL_TRIGGER_STATS
+        const Uint64 start = SDL_GetPerformanceCounter();
+        callbacks[index]();
+        const Uint64 ticks = SDL_GetPerformanceCounter() - start;
+
+        // the callback may have registered new triggers
+        triggers[index].stats.callbackTicks.add(ticks);
+        triggers[index].stats.maxCallbackTicks.raiseTo(ticks);
+#else
+        callbacks[index]();
+#endif
+
+        // the triggers unbound by the callbacks can be reused now
+        if (--firingDepth == 0 && !unboundTriggers.empty()) {
+            for (auto unbound : unboundTriggers) {
+                callbacks[unbound] = Callback();
+                freeTriggers.push_back(unbound);
+            }
+            unboundTriggers.clear();
+        }
+    }
+
+    bool Group::processEvent(const SDL_Event& e) {
+        const SDL_Keycode code = codeOf(e.key.keysym);
+        const Uint32 current = epoch;
+
+        hasFulfilled = false;
+
+        if (e.type == SDL_KEYDOWN && e.key.repeat == 0) {
+            SDL_TRIGGER_COUNT(stats.keypresses);
+
+            const Uint32 press = context.keyboard.presses;
+
+            // the triggers holding the key, with the slots they hold it in
+            const KeySlots* first = NULL;
+            const KeySlots* last = NULL;
+            if (evaluation == INDEXED) {
+                const auto found = findKeySlots(code);
+                if (found != NULL) {
+                    first = found->data();
+                    last = first + found->size();
+                }
+            } else {
+                first = packedHits.data();
+                last = first + scanPacked(code);
+            }
+
+            auto& matched = nextCandidates();
+            matched.clear();
+            for (auto entry = first; entry != last; entry++) {
+                auto& trigger = triggers[entry->trigger];
+
+                // any other key pressed since resets the combination,
+                // so triggers without this key need no work at all
+                if (trigger.epoch != current) {
+                    trigger.combination.reset();
+                    trigger.epoch = current;
+                } else if (trigger.lastPress == 0 || trigger.lastPress + 1 != press) {
+#ifdef SDL_TRIGGER_STATS
+                    if (trigger.combination.downMask != 0) {
+                        trigger.stats.resets.add(1);
+                    }
+#endif
+                    trigger.combination.reset();
+                }
+                trigger.lastPress = press;
+                trigger.combination.markKeysDown(entry->slots);
+                SDL_TRIGGER_COUNT(trigger.stats.evaluations);
+
+                matched.push_back(entry->trigger);
+            }
+
+            // only the touched and the keyless triggers can be fulfilled,
+            // merge them to keep the slot order of the callbacks
+            if (!keylessTriggers.empty()) {
+                const size_t touched = matched.size();
+                matched.insert(matched.end(), keylessTriggers.begin(), keylessTriggers.end());
+                std::inplace_merge(matched.begin(), matched.begin() + touched, matched.end());
+
+                for (auto index : keylessTriggers) {
+                    triggers[index].lastPress = press;
+                }
+            }
+
+            matchingDepth++;
+            for (auto index : matched) {
+                // a callback unbound or rebound it meanwhile
+                if (triggers[index].lastPress != press) {
+                    continue;
+                }
+
+                if (!isFulfilled(triggers[index])) {
+                    SDL_TRIGGER_COUNT(triggers[index].stats.partialMatches);
+                    continue;
+                }
+
+                switch (triggers[index].kind) {
+                    case Trigger::HOLD:
+                        startTimer(index, e.key.timestamp);
+                        break;
+                    case Trigger::REPEAT:
+                        startTimer(index, e.key.timestamp);
+                        fulfil(index);
+                        break;
+                    case Trigger::RELEASE:
+                        break; // fired by the release of one of its keys
+                    case Trigger::MODIFIED:
+                        if (triggers[index].matchesModifiers(e.key.keysym.mod)) {
+                            fulfil(index);
+                        } else {
+                            SDL_TRIGGER_COUNT(triggers[index].stats.partialMatches);
+                        }
+                        break;
+                    default:
+                        fulfil(index);
+                        break;
+                }
+            }
+            matchingDepth--;
+
+            if (!sequenceNodes.empty() && !sequenceNodes[0].chords.empty()) {
+                advanceSequences(e);
+            }
+        } else if (e.type == SDL_KEYUP && hasReleaseTriggers) {
+            release(code);
+        }
+
+        return isConsuming && hasFulfilled;
+    }
+
+    Context::Context() : keyboard{}, timers{}, deferred{false}, eventHook{NULL}, eventHookUserdata{NULL}, pendingCallbacks{}, dispatchedCallbacks{},
+                         changes{0}, groups{}, walkDepth{0}, placedAfterWalk{}, hasDestroyedWhileWalking{false}, groupsMutex{}, globalGroup(*this) {
+        //
+    }
+
+    bool Context::isKeyDown(SDL_Keycode key) const {
+        return keyboard.isKeyDown(key);
+    }
+
+    bool Context::isScancodeDown(SDL_Scancode scancode) const {
+        return keyboard.isScancodeDown(scancode);
+    }
+
+    Uint32 Context::changeCount() const {
+        return changes;
+    }
+
+    void Context::setDeferred(bool isDeferred, size_t capacity) {
+        deferred = isDeferred;
+        pendingCallbacks.reserve(capacity);
+        dispatchedCallbacks.reserve(capacity);
+    }
+
+    bool Context::isDeferred() const {
+        return deferred;
+    }
+
+    bool PendingCallback::isCurrent() const {
+        return group != NULL && group->epoch == epoch && group->isCurrent(trigger, generation);
+    }
+
+    void PendingCallback::operator()() const {
+        if (isCurrent()) {
+            group->fire(trigger);
+        }
+    }
+
+    size_t Context::dispatchPending(DispatchHook hook, void* userdata) {
+        std::lock_guard<std::recursive_mutex> lock(groupsMutex);
+
+        // callbacks queued by the callbacks themselves wait for the next call
+        std::swap(pendingCallbacks, dispatchedCallbacks);
+
+        size_t called = 0;
+        for (size_t i = 0; i < dispatchedCallbacks.size(); i++) {
+            if (dispatchedCallbacks[i].isCurrent()) {
+                if (hook != NULL) {
+                    hook(dispatchedCallbacks[i], userdata);
+                }
+                dispatchedCallbacks[i]();
+                called++;
+            }
+        }
+        dispatchedCallbacks.clear();
+
+        return called;
+    }
+
+    void Context::takePending(std::vector<PendingCallback>& into) {
+        std::lock_guard<std::recursive_mutex> lock(groupsMutex);
+
+        into.clear();
+        std::swap(pendingCallbacks, into);
+    }
+#ifdef SDL_TRIGGER_STATS
+    std::vector<GroupStatsSnapshot> Context::snapshotStats() {
+        // the counters are atomic and the groups and their bound keys only
+        // change under the lock of the stats, so the events are processed
+        // meanwhile, and the output is sized by a first look at them
+        size_t groupCount = 0;
+        size_t triggerCount = 0;
+        size_t keyCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            for (const auto group : groups) {
+                if (group != NULL) {
+                    groupCount++;
+                    triggerCount += group->triggers.size();
+                    keyCount += group->keys.size();
+                }
+            }
+        }
+
+        std::vector<GroupStatsSnapshot> snapshots;
+        std::vector<TriggerStatsSnapshot> triggerSnapshots;
+        std::vector<size_t> triggerCounts; // of every group
+        std::vector<size_t> keyCounts;     // of every trigger
+        Keycodes boundKeys;
+        snapshots.reserve(groupCount);
+        triggerCounts.reserve(groupCount);
+        triggerSnapshots.reserve(triggerCount);
+        keyCounts.reserve(triggerCount);
+        boundKeys.reserve(keyCount);
+
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            for (const auto group : groups) {
+                // destroyed by a callback of the event being processed
+                if (group == NULL) {
+                    continue;
+                }
+
+                snapshots.push_back({group, group->stats.keypresses.load(), group->stats.fires.load(), {}});
+                triggerCounts.push_back(0);
+
+                for (size_t index = 0; index < group->triggers.size(); index++) {
+                    const auto& trigger = group->triggers[index];
+                    if (trigger.isFree) {
+                        continue;
+                    }
+
+                    TriggerStatsSnapshot triggerSnapshot;
+                    triggerSnapshot.trigger = index;
+                    triggerSnapshot.evaluations = trigger.stats.evaluations.load();
+                    triggerSnapshot.partialMatches = trigger.stats.partialMatches.load();
+                    triggerSnapshot.resets = trigger.stats.resets.load();
+                    triggerSnapshot.fires = trigger.stats.fires.load();
+                    triggerSnapshot.callbackTicks = trigger.stats.callbackTicks.load();
+                    triggerSnapshot.maxCallbackTicks = trigger.stats.maxCallbackTicks.load();
+                    triggerSnapshots.push_back(std::move(triggerSnapshot));
+                    triggerCounts.back()++;
+
+                    keyCounts.push_back(trigger.combination.keyCount);
+                    for (size_t slot = 0; slot < trigger.combination.keyCount; slot++) {
+                        boundKeys.push_back(group->keyOf(trigger, slot));
+                    }
+                }
+            }
+        }
+
+        // the key lists and the trigger lists are allocated after the lock
+        auto key = boundKeys.begin();
+        for (size_t i = 0; i < triggerSnapshots.size(); i++) {
+            triggerSnapshots[i].keys.assign(key, key + keyCounts[i]);
+            key += keyCounts[i];
+        }
+
+        auto moved = std::make_move_iterator(triggerSnapshots.begin());
+        for (size_t i = 0; i < snapshots.size(); i++) {
+            snapshots[i].triggers.assign(moved, moved + triggerCounts[i]);
+            moved += triggerCounts[i];
+        }
+
+        return snapshots;
+    }
+#endif
+
+    void Context::setEventHook(EventHook hook, void* userdata) {
+        std::lock_guard<std::recursive_mutex> lock(groupsMutex);
+
+        eventHook = hook;
+        eventHookUserdata = userdata;
+    }
+
+    void Context::tick(Uint32 now) {
+        std::lock_guard<std::recursive_mutex> lock(groupsMutex);
+        timers.advance(now);
+    }
+
+    void Context::processEvent(const SDL_Event& e) {
+        processEvents(&e, 1);
+    }
+
+    void Context::processEvents(const SDL_Event* events, size_t count) {
+        std::lock_guard<std::recursive_mutex> lock(groupsMutex);
+
+        for (size_t i = 0; i < count; i++) {
+            const SDL_Event& e = events[i];
+
+            if (e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) {
+                continue;
+            }
+
+            if (eventHook != NULL) {
+                eventHook(e, eventHookUserdata);
+            }
+
+            // timers due until the event expire while its key is in the old state
+            timers.advance(e.key.timestamp);
+            keyboard.processEvent(e);
+
+            // repeated keypresses are only tracked by the keyboard state,
+            // releases only matter to groups with release triggers
+            const bool isPress = e.type == SDL_KEYDOWN && e.key.repeat == 0;
+            if (e.type == SDL_KEYDOWN && !isPress) {
+                continue;
+            }
+            changes++;
+
+            // every group sees the event once, in the order it arrived in
+            walkDepth++;
+            for (size_t index = 0; index < groups.size(); index++) {
+                Group* group = groups[index];
+                if (group != NULL && group->isEnabled && (isPress || group->hasReleaseTriggers) && group->processEvent(e)) {
+                    break;
+                }
+            }
+
+            if (--walkDepth == 0 && (hasDestroyedWhileWalking || !placedAfterWalk.empty())) {
+                placeAfterWalk(*this);
+            }
+        }
+    }
+
+    void Context::processEvents(const std::vector<SDL_Event>& events) {
+        processEvents(events.data(), events.size());
+    }
+
+    Handle on(SDL_Keycode key, Callback callback) {
+        return defaultContext().globalGroup.on(key, std::move(callback));
+    }
+
+    Handle on(std::initializer_list<SDL_Keycode> keys, Callback callback) {
+        return defaultContext().globalGroup.on(keys, std::move(callback));
+    }
+
+    Handle on(const Keycodes& keys, Callback callback) {
+        return defaultContext().globalGroup.on(keys, std::move(callback));
+    }
+
+    Handle onScancode(SDL_Scancode scancode, Callback callback) {
+        return defaultContext().globalGroup.onScancode(scancode, std::move(callback));
+    }
+
+    Handle onScancode(std::initializer_list<SDL_Scancode> scancodes, Callback callback) {
+        return defaultContext().globalGroup.onScancode(scancodes, std::move(callback));
+    }
+
+    Handle onModified(Uint16 modifiers, SDL_Keycode key, Callback callback) {
+        return defaultContext().globalGroup.onModified(modifiers, key, std::move(callback));
+    }
+
+    Handle onSequence(std::initializer_list<std::initializer_list<SDL_Keycode>> steps, Callback callback) {
+        return defaultContext().globalGroup.onSequence(steps, std::move(callback));
+    }
+
+    Handle onSequence(const std::vector<Keycodes>& steps, Callback callback) {
+        return defaultContext().globalGroup.onSequence(steps, std::move(callback));
+    }
+
+    Handle onHold(std::initializer_list<SDL_Keycode> keys, Uint32 milliseconds, Callback callback) {
+        return defaultContext().globalGroup.onHold(keys, milliseconds, std::move(callback));
+    }
+
+    Handle onHold(const Keycodes& keys, Uint32 milliseconds, Callback callback) {
+        return defaultContext().globalGroup.onHold(keys, milliseconds, std::move(callback));
+    }
+
+    Handle onRepeat(std::initializer_list<SDL_Keycode> keys, Uint32 interval, Callback callback) {
+        return defaultContext().globalGroup.onRepeat(keys, interval, std::move(callback));
+    }
+
+    Handle onRepeat(const Keycodes& keys, Uint32 interval, Callback callback) {
+        return defaultContext().globalGroup.onRepeat(keys, interval, std::move(callback));
+    }
+
+    Handle onRelease(std::initializer_list<SDL_Keycode> keys, Callback callback) {
+        return defaultContext().globalGroup.onRelease(keys, std::move(callback));
+    }
+
+    Handle onRelease(const Keycodes& keys, Callback callback) {
+        return defaultContext().globalGroup.onRelease(keys, std::move(callback));
+    }
+
+    bool off(Handle handle) {
+        return defaultContext().globalGroup.off(handle);
+    }
+
+    void rebind(Handle handle, std::initializer_list<SDL_Keycode> keys) {
+        defaultContext().globalGroup.rebind(handle, keys);
+    }
+
+    void rebind(Handle handle, const Keycodes& keys) {
+        defaultContext().globalGroup.rebind(handle, keys);
+    }
+
+    bool isKeyDown(SDL_Keycode key) {
+        return defaultContext().isKeyDown(key);
+    }
+
+    bool isScancodeDown(SDL_Scancode scancode) {
+        return defaultContext().isScancodeDown(scancode);
+    }
+
+    Uint32 changeCount() {
+        return defaultContext().changeCount();
+    }
+
+    void setDeferred(bool isDeferred, size_t capacity) {
+        defaultContext().setDeferred(isDeferred, capacity);
+    }
+
+    bool isDeferred() {
+        return defaultContext().isDeferred();
+    }
+
+    size_t dispatchPending() {
+        return defaultContext().dispatchPending();
+    }
+
+    void takePending(std::vector<PendingCallback>& into) {
+        defaultContext().takePending(into);
+    }
+
+#ifdef SDL_TRIGGER_STATS
+    std::vector<GroupStatsSnapshot> snapshotStats() {
+        return defaultContext().snapshotStats();
+    }
+#endif
+
+    void setEventHook(EventHook hook, void* userdata) {
+        defaultContext().setEventHook(hook, userdata);
+    }
+
+    void tick(Uint32 now) {
+        defaultContext().tick(now);
+    }
+
+    void processEvent(const SDL_Event& e) {
+        defaultContext().processEvent(e);
+    }
+
+    void processEvents(const SDL_Event* events, size_t count) {
+        defaultContext().processEvents(events, count);
+    }
+
+    void processEvents(const std::vector<SDL_Event>& events) {
+        defaultContext().processEvents(events);
+    }
+
 } // namespace Trigger
@@ -0,0 +1,427 @@
+#include "sdl_trigger_keymap.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+
+namespace Trigger {
+
+    const char KEYMAP_MAGIC[8] = {'S', 'D', 'L', 'T', 'K', 'M', 'A', 'P'};
+
+    void CallbackRegistry::add(const std::string& name, Callback callback) {
+        auto& entry = entries[name];
+        if (entry == nullptr) {
+            entry = std::make_shared<Entry>();
+        }
+
+        // replaced in the shared entry, so the keymaps naming it see the new one,
+        // while the old one lives on in the fire() calling it, if any
+        entry->callback = std::make_shared<Callback>(std::move(callback));
+    }
+
+    std::shared_ptr<CallbackRegistry::Entry> CallbackRegistry::find(const std::string& name) const {
+        const auto found = entries.find(name);
+        return found != entries.end() ? found->second : nullptr;
+    }
+
+    static Uint32 fulfilledMaskOf(size_t keyCount) {
+        return keyCount == KeyCombination::MAX_KEYS ? ~Uint32{0} : (Uint32{1} << keyCount) - 1;
+    }
+
+    static std::string trim(const std::string& text) {
+        const size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            return "";
+        }
+        return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+    }
+
+    static SDL_Keycode parseKey(const std::string& name, const std::string& where) {
+        if (name.empty()) {
+            throw std::runtime_error(where + ": empty key name!");
+        }
+
+        // decimal numbers would be taken for the digit keys
+        if (name.size() > 2 && name[0] == '0' && (name[1] == 'x' || name[1] == 'X')) {
+            char* end = NULL;
+            const unsigned long keycode = std::strtoul(name.c_str() + 2, &end, 16);
+            if (*end != '\0' || keycode > 0xFFFFFFFFul) {
+                throw std::runtime_error(where + ": invalid keycode " + name + "!");
+            }
+            return static_cast<SDL_Keycode>(keycode);
+        }
+
+        const SDL_Keycode key = SDL_GetKeyFromName(name.c_str());
+        if (key == SDLK_UNKNOWN) {
+            throw std::runtime_error(where + ": unknown key " + name + "!");
+        }
+        return key;
+    }
+
+    void compileKeymap(const std::string& textPath, const std::string& keymapPath) {
+        std::vector<KeymapBinding> bindings;
+        Keycodes keys;
+        std::map<SDL_Keycode, std::vector<KeymapEntry>> entriesByKey;
+        std::vector<std::string> names;
+        std::unordered_map<std::string, Uint32> nameIds;
+
+        {
+            const MappedFile text(textPath);
+            const char* bytes = reinterpret_cast<const char*>(text.data());
+            size_t lineStart = 0;
+
+            for (size_t lineNumber = 1; lineStart < text.size(); lineNumber++) {
+                const char* lineEnd = static_cast<const char*>(std::memchr(bytes + lineStart, '\n', text.size() - lineStart));
+                const size_t length = lineEnd != NULL ? lineEnd - (bytes + lineStart) : text.size() - lineStart;
+                const std::string line = trim(std::string(bytes + lineStart, length));
+                const std::string where = textPath + ":" + std::to_string(lineNumber);
+                lineStart += length + 1;
+
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+
+                // the last one, the = key can be bound too
+                const size_t separator = line.rfind('=');
+                if (separator == std::string::npos) {
+                    throw std::runtime_error(where + ": no '=' before the callback!");
+                }
+
+                const std::string name = trim(line.substr(separator + 1));
+                if (name.empty()) {
+                    throw std::runtime_error(where + ": no callback after the '='!");
+                }
+
+                KeymapBinding binding;
+                binding.firstKey = keys.size();
+                binding.keyCount = 0;
+
+                const std::string keyList = line.substr(0, separator);
+                size_t keyStart = 0;
+                while (true) {
+                    const size_t keyEnd = keyList.find('+', keyStart);
+                    const SDL_Keycode key = parseKey(trim(keyList.substr(keyStart, keyEnd - keyStart)), where);
+
+                    if (binding.keyCount == KeyCombination::MAX_KEYS) {
+                        throw std::runtime_error(where + ": too many keys in a single key combination!");
+                    }
+
+                    // a key repeated in the combination has a single entry
+                    auto& entries = entriesByKey[key];
+                    if (entries.empty() || entries.back().binding != bindings.size()) {
+                        entries.push_back({static_cast<Uint32>(bindings.size()), 0});
+                    }
+                    entries.back().slots |= Uint32{1} << binding.keyCount;
+
+                    keys.push_back(key);
+                    binding.keyCount++;
+
+                    if (keyEnd == std::string::npos) {
+                        break;
+                    }
+                    keyStart = keyEnd + 1;
+                }
+
+                const auto id = nameIds.insert({name, static_cast<Uint32>(names.size())});
+                if (id.second) {
+                    names.push_back(name);
+                }
+                binding.callback = id.first->second;
+
+                bindings.push_back(binding);
+            }
+        }
+
+        // every array is made of 32 bit words, so the whole file is swapped word by word
+        std::vector<Uint32> words;
+        for (const auto& binding : bindings) {
+            words.push_back(binding.firstKey);
+            words.push_back(binding.keyCount);
+            words.push_back(binding.callback);
+        }
+        for (auto key : keys) {
+            words.push_back(static_cast<Uint32>(key));
+        }
+
+        Uint32 entryCount = 0;
+        for (const auto& key : entriesByKey) {
+            words.push_back(static_cast<Uint32>(key.first));
+            words.push_back(entryCount);
+            words.push_back(key.second.size());
+            entryCount += key.second.size();
+        }
+        for (const auto& key : entriesByKey) {
+            for (const auto& entry : key.second) {
+                words.push_back(entry.binding);
+                words.push_back(entry.slots);
+            }
+        }
+
+        std::string nameBytes;
+        for (const auto& name : names) {
+            words.push_back(nameBytes.size());
+            nameBytes += name;
+        }
+        words.push_back(nameBytes.size());
+
+        for (auto& word : words) {
+            word = SDL_SwapLE32(word);
+        }
+
+        KeymapHeader header;
+        std::memcpy(header.magic, KEYMAP_MAGIC, sizeof(header.magic));
+        header.version = SDL_SwapLE32(KEYMAP_VERSION);
+        header.bindingCount = SDL_SwapLE32(static_cast<Uint32>(bindings.size()));
+        header.keyCount = SDL_SwapLE32(static_cast<Uint32>(keys.size()));
+        header.indexCount = SDL_SwapLE32(static_cast<Uint32>(entriesByKey.size()));
+        header.entryCount = SDL_SwapLE32(entryCount);
+        header.callbackCount = SDL_SwapLE32(static_cast<Uint32>(names.size()));
+        header.nameBytes = SDL_SwapLE32(static_cast<Uint32>(nameBytes.size()));
+        header.padding = 0;
+
+        // written next to it and renamed over it, so a keymap loaded from
+        // the path keeps its mapped bytes and a failed compile keeps the old one
+        const std::string writtenPath = keymapPath + ".tmp";
+        SDL_RWops* file = SDL_RWFromFile(writtenPath.c_str(), "wb");
+        if (file == NULL) {
+            throw std::runtime_error("Could not create " + writtenPath + "!");
+        }
+
+        const bool isWritten = SDL_RWwrite(file, &header, sizeof(header), 1) == 1 &&
+                               (words.empty() || SDL_RWwrite(file, words.data(), sizeof(Uint32), words.size()) == words.size()) &&
+                               (nameBytes.empty() || SDL_RWwrite(file, nameBytes.data(), 1, nameBytes.size()) == nameBytes.size());
+        const bool isClosed = SDL_RWclose(file) == 0;
+
+        if (!isWritten || !isClosed) {
+            std::remove(writtenPath.c_str());
+            throw std::runtime_error("Could not write " + writtenPath + "!");
+        }
+
+        if (std::rename(writtenPath.c_str(), keymapPath.c_str()) != 0) {
+            std::remove(writtenPath.c_str());
+            throw std::runtime_error("Could not replace " + keymapPath + "!");
+        }
+    }
+
+    Keymap::Keymap(const std::string& path, CallbackRegistry& registry) : file{path, false}, bindings{NULL}, keys{NULL}, index{NULL}, entries{NULL},
+                                                                         count{0}, indexCount{0}, callbacks{}, states{} {
+        KeymapHeader header;
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error(path + " is not a keymap!");
+        }
+
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, KEYMAP_MAGIC, sizeof(header.magic)) != 0 || SDL_SwapLE32(header.version) != KEYMAP_VERSION) {
+            throw std::runtime_error(path + " is not a keymap of this version!");
+        }
+
+        const Uint64 bindingCount = SDL_SwapLE32(header.bindingCount);
+        const Uint64 keyCount = SDL_SwapLE32(header.keyCount);
+        const Uint64 entryCount = SDL_SwapLE32(header.entryCount);
+        const Uint64 callbackCount = SDL_SwapLE32(header.callbackCount);
+        const Uint64 nameBytes = SDL_SwapLE32(header.nameBytes);
+        indexCount = SDL_SwapLE32(header.indexCount);
+
+        const Uint64 words = bindingCount * 3 + keyCount + indexCount * 3 + entryCount * 2 + callbackCount + 1;
+        if (sizeof(header) + words * sizeof(Uint32) + nameBytes != file.size()) {
+            throw std::runtime_error(path + " is damaged!");
+        }
+
+        const Uint32* word = reinterpret_cast<const Uint32*>(file.data() + sizeof(header));
+        bindings = reinterpret_cast<const KeymapBinding*>(word);
+        keys = reinterpret_cast<const Sint32*>(word + bindingCount * 3);
+        index = reinterpret_cast<const KeymapKey*>(word + bindingCount * 3 + keyCount);
+        entries = reinterpret_cast<const KeymapEntry*>(word + bindingCount * 3 + keyCount + indexCount * 3);
+        const Uint32* nameOffsets = word + bindingCount * 3 + keyCount + indexCount * 3 + entryCount * 2;
+        const char* names = reinterpret_cast<const char*>(nameOffsets + callbackCount + 1);
+        count = bindingCount;
+
+        // checked once here, so matching can trust every offset
+        for (size_t binding = 0; binding < count; binding++) {
+            const Uint64 firstKey = SDL_SwapLE32(bindings[binding].firstKey);
+            const Uint32 bindingKeys = SDL_SwapLE32(bindings[binding].keyCount);
+            if (bindingKeys == 0 || bindingKeys > KeyCombination::MAX_KEYS || firstKey + bindingKeys > keyCount ||
+                SDL_SwapLE32(bindings[binding].callback) >= callbackCount) {
+                throw std::runtime_error(path + " is damaged!");
+            }
+        }
+
+        for (size_t key = 0; key < indexCount; key++) {
+            const Uint64 firstEntry = SDL_SwapLE32(index[key].firstEntry);
+            const Uint32 keyEntries = SDL_SwapLE32(index[key].entryCount);
+            if (firstEntry + keyEntries > entryCount ||
+                (key > 0 && static_cast<Sint32>(SDL_SwapLE32(index[key].key)) <= static_cast<Sint32>(SDL_SwapLE32(index[key - 1].key)))) {
+                throw std::runtime_error(path + " is damaged!");
+            }
+
+            for (Uint64 entry = firstEntry; entry < firstEntry + keyEntries; entry++) {
+                const Uint32 binding = SDL_SwapLE32(entries[entry].binding);
+                const Uint32 slots = SDL_SwapLE32(entries[entry].slots);
+                if (binding >= count || (entry > firstEntry && binding <= SDL_SwapLE32(entries[entry - 1].binding)) ||
+                    slots == 0 || (slots & ~fulfilledMaskOf(this->keyCount(binding))) != 0) {
+                    throw std::runtime_error(path + " is damaged!");
+                }
+            }
+        }
+
+        callbacks.reserve(callbackCount);
+        for (size_t id = 0; id < callbackCount; id++) {
+            const Uint32 first = SDL_SwapLE32(nameOffsets[id]);
+            const Uint32 last = SDL_SwapLE32(nameOffsets[id + 1]);
+            if (first > last || last > nameBytes) {
+                throw std::runtime_error(path + " is damaged!");
+            }
+
+            const std::string name(names + first, last - first);
+            std::shared_ptr<CallbackRegistry::Entry> callback = registry.find(name);
+            if (callback == nullptr) {
+                throw std::runtime_error("Unknown callback " + name + " in " + path + "!");
+            }
+            callbacks.push_back(std::move(callback));
+        }
+
+        states.assign(count, State{0, 0, 0});
+    }
+
+    size_t Keymap::bindingCount() const {
+        return count;
+    }
+
+    size_t Keymap::keyCount(size_t binding) const {
+        return SDL_SwapLE32(bindings[binding].keyCount);
+    }
+
+    SDL_Keycode Keymap::keyOf(size_t binding, size_t slot) const {
+        return static_cast<SDL_Keycode>(SDL_SwapLE32(keys[SDL_SwapLE32(bindings[binding].firstKey) + slot]));
+    }
+
+    const KeymapEntry* Keymap::findEntries(SDL_Keycode key, size_t& entryCount) const {
+        const auto found = std::lower_bound(index, index + indexCount, key, [](const KeymapKey& entry, SDL_Keycode key) {
+            return static_cast<Sint32>(SDL_SwapLE32(entry.key)) < key;
+        });
+
+        if (found == index + indexCount || static_cast<Sint32>(SDL_SwapLE32(found->key)) != key) {
+            entryCount = 0;
+            return NULL;
+        }
+
+        entryCount = SDL_SwapLE32(found->entryCount);
+        return entries + SDL_SwapLE32(found->firstEntry);
+    }
+
+    std::shared_ptr<Callback> Keymap::callbackOf(size_t binding) const {
+        return callbacks[SDL_SwapLE32(bindings[binding].callback)]->callback;
+    }
+
+    Keymap::State& Keymap::stateOf(size_t binding) {
+        return states[binding];
+    }
+
+    KeymapGroup::KeymapGroup(CallbackRegistry& registry, Context& context) : Group(context), registry(registry), loaded{}, pending{NULL} {
+        //
+    }
+
+    KeymapGroup::~KeymapGroup() {
+        delete pending.exchange(NULL);
+    }
+
+    const Group& KeymapGroup::group() const {
+        return *this;
+    }
+
+    void KeymapGroup::load(const std::string& path) {
+        std::unique_ptr<Keymap> next(new Keymap(path, registry));
+
+        // an earlier reload would replace it at the next event
+        delete pending.exchange(NULL);
+        takeOver(next.release());
+    }
+
+    void KeymapGroup::reload(const std::string& path) {
+        Keymap* next = new Keymap(path, registry);
+
+        // one that was not taken over yet is never used
+        delete pending.exchange(next, std::memory_order_acq_rel);
+    }
+
+    const Keymap* KeymapGroup::keymap() const {
+        return loaded.get();
+    }
+
+    void KeymapGroup::takeOver(Keymap* next) {
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+
+        // the bindings of the old one are gone, like after off(), and the
+        // new epoch stops matching them if it is taken over from a callback
+        dropPending();
+        epoch++;
+        loaded.reset(next);
+        context.changes++;
+    }
+
+    bool KeymapGroup::processEvent(const SDL_Event& e) {
+        // a reloaded keymap is taken over between two events
+        if (pending.load(std::memory_order_relaxed) != NULL) {
+            takeOver(pending.exchange(NULL, std::memory_order_acq_rel));
+        }
+
+        hasFulfilled = false;
+
+        if (loaded != nullptr && e.type == SDL_KEYDOWN && e.key.repeat == 0) {
+#ifdef SDL_TRIGGER_STATS
+            stats.keypresses.add(1);
+#endif
+
+            const Uint32 press = context.keyboard.presses;
+            const Uint32 current = epoch;
+
+            size_t entryCount = 0;
+            const KeymapEntry* found = loaded->findEntries(e.key.keysym.sym, entryCount);
+
+            // in binding order, like the triggers of a group, so are the callbacks,
+            // until a callback resets the group or takes another keymap over
+            for (size_t i = 0; i < entryCount && epoch == current; i++) {
+                const size_t binding = SDL_SwapLE32(found[i].binding);
+                const size_t keyCount = loaded->keyCount(binding);
+                Keymap::State& state = loaded->stateOf(binding);
+
+                // any other key pressed since resets the combination
+                if (state.epoch != current || state.lastPress == 0 || state.lastPress + 1 != press) {
+                    state.downMask = 0;
+                    state.epoch = current;
+                }
+                state.lastPress = press;
+                state.downMask |= SDL_SwapLE32(found[i].slots);
+
+                if (state.downMask != fulfilledMaskOf(keyCount)) {
+                    continue;
+                }
+
+                bool areKeysDown = true;
+                for (size_t slot = 0; slot < keyCount && areKeysDown; slot++) {
+                    areKeysDown = context.keyboard.isKeyDown(loaded->keyOf(binding, slot));
+                }
+
+                if (areKeysDown) {
+                    fulfil(binding, 0);
+                }
+            }
+        }
+
+        return isConsuming && hasFulfilled;
+    }
+
+    bool KeymapGroup::isCurrent(size_t, Uint32) const {
+        // the callbacks queued for a replaced keymap are dropped when it is taken over
+        return true;
+    }
+
+    void KeymapGroup::fire(size_t index) {
+        // a copy, the callback may replace itself in the registry or take
+        // another keymap over, and both would destroy it while it runs
+        const std::shared_ptr<Callback> callback = loaded->callbackOf(index);
+        (*callback)();
+    }
+
+} // namespace Trigger
@@ -0,0 +1,134 @@
+#include "sdl_trigger_pipeline.h"
+
+namespace Trigger {
+
+    Pipeline::Pipeline(size_t capacity, Context& context) : context(context), events{capacity}, fulfilled{capacity}, isRunning{false}, matched{0}, spillMutex{}, spilled{}, hasSpilled{false}, wasDeferred{false}, worker{} {
+        //
+    }
+
+    Pipeline::~Pipeline() {
+        stop();
+    }
+
+    void Pipeline::start() {
+        if (isRunning) {
+            return;
+        }
+
+        wasDeferred = context.isDeferred();
+        context.setDeferred(true, fulfilled.capacity());
+
+        isRunning = true;
+        worker = std::thread(&Pipeline::run, this);
+    }
+
+    void Pipeline::stop() {
+        if (!isRunning) {
+            return;
+        }
+
+        isRunning = false;
+        worker.join();
+
+        context.setDeferred(wasDeferred);
+    }
+
+    bool Pipeline::push(const SDL_Event& e) {
+        // the worker has nothing to do with other events
+        if (e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) {
+            return true;
+        }
+
+        return events.push(e);
+    }
+
+    size_t Pipeline::dispatch() {
+        size_t called = 0;
+        auto call = [&called](const PendingCallback& pending) {
+            if (pending.isCurrent()) {
+                pending();
+                called++;
+            }
+        };
+
+        PendingCallback pending;
+        while (fulfilled.pop(pending)) {
+            call(pending);
+        }
+
+        // the worker pushes nothing once it spills, so after the rest of the
+        // ring the spilled ones keep the order they were fulfilled in
+        if (hasSpilled.load(std::memory_order_acquire)) {
+            std::vector<PendingCallback> later;
+            {
+                std::lock_guard<std::mutex> lock(spillMutex);
+                later.swap(spilled);
+                hasSpilled = false;
+            }
+
+            while (fulfilled.pop(pending)) {
+                call(pending);
+            }
+            for (const auto& callback : later) {
+                call(callback);
+            }
+        }
+
+        return called;
+    }
+
+    Uint64 Pipeline::matchedEvents() const {
+        return matched.load(std::memory_order_acquire);
+    }
+
+    void Pipeline::run() {
+        std::vector<SDL_Event> batch;
+        std::vector<PendingCallback> pending;
+        batch.reserve(events.capacity());
+        pending.reserve(fulfilled.capacity());
+
+        SDL_Event e;
+        bool isSpilling = false;
+        while (true) {
+            // checked before draining, so nothing pushed before stop() is lost
+            const bool isStopping = !isRunning;
+
+            batch.clear();
+            while (batch.size() < events.capacity() && events.pop(e)) {
+                batch.push_back(e);
+            }
+
+            if (batch.empty()) {
+                if (isStopping) {
+                    break;
+                }
+
+                std::this_thread::yield();
+                continue;
+            }
+
+            context.processEvents(batch);
+            context.takePending(pending);
+
+            // the consumer may lag behind, never drop a callback, but it
+            // may also be the thread waiting in stop(), then the rest is spilled
+            for (const auto& callback : pending) {
+                while (!isSpilling && !fulfilled.push(callback)) {
+                    isSpilling = !isRunning;
+                    if (!isSpilling) {
+                        std::this_thread::yield();
+                    }
+                }
+
+                if (isSpilling) {
+                    std::lock_guard<std::mutex> lock(spillMutex);
+                    spilled.push_back(callback);
+                    hasSpilled = true;
+                }
+            }
+
+            matched.fetch_add(batch.size(), std::memory_order_release);
+        }
+    }
+
+} // namespace Trigger
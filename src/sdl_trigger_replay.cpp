@@ -0,0 +1,271 @@
+#include "sdl_trigger_replay.h"
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SDL_TRIGGER_HAS_MMAP 1
+#endif
+
+namespace Trigger {
+
+    const char RECORDING_MAGIC[8] = {'S', 'D', 'L', 'T', 'R', 'E', 'C', '\0'};
+
+    // magic, version and record size, padded to a whole record
+    struct RecordingHeader {
+        char magic[8];
+        Uint32 version;
+        Uint32 recordSize;
+    };
+    static_assert(sizeof(RecordingHeader) == sizeof(RecordedEvent), "RecordingHeader must keep the records aligned!");
+
+    RecordedEvent RecordedEvent::of(const SDL_Event& e) {
+        RecordedEvent recorded;
+        recorded.timestamp = SDL_SwapLE32(e.key.timestamp);
+        recorded.key = SDL_SwapLE32(e.key.keysym.sym);
+        recorded.scancode = SDL_SwapLE16(static_cast<Uint16>(e.key.keysym.scancode));
+        recorded.mod = SDL_SwapLE16(e.key.keysym.mod);
+        recorded.isDown = e.type == SDL_KEYDOWN;
+        recorded.repeat = e.key.repeat;
+        recorded.padding = 0;
+        return recorded;
+    }
+
+    SDL_Event RecordedEvent::toEvent() const {
+        SDL_Event e;
+        std::memset(&e, 0, sizeof(e));
+        e.type = isDown ? SDL_KEYDOWN : SDL_KEYUP;
+        e.key.timestamp = SDL_SwapLE32(timestamp);
+        e.key.state = isDown ? SDL_PRESSED : SDL_RELEASED;
+        e.key.repeat = repeat;
+        e.key.keysym.sym = SDL_SwapLE32(key);
+        e.key.keysym.scancode = static_cast<SDL_Scancode>(SDL_SwapLE16(scancode));
+        e.key.keysym.mod = SDL_SwapLE16(mod);
+        return e;
+    }
+
+    MappedFile::MappedFile(const std::string& path, bool isSequential) : bytes{NULL}, length{0}, isMapped{false} {
+#ifdef SDL_TRIGGER_HAS_MMAP
+        const int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw std::runtime_error("Could not open " + path + "!");
+        }
+
+        struct stat status;
+        if (fstat(descriptor, &status) != 0) {
+            close(descriptor);
+            throw std::runtime_error("Could not stat " + path + "!");
+        }
+
+        length = status.st_size;
+        if (length > 0) {
+            void* mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapped == MAP_FAILED) {
+                close(descriptor);
+                throw std::runtime_error("Could not map " + path + "!");
+            }
+
+            // replays read it front to back, keymaps are looked up right away
+            madvise(mapped, length, isSequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+
+            bytes = static_cast<const Uint8*>(mapped);
+            isMapped = true;
+        }
+
+        close(descriptor);
+#else
+        SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+        if (file == NULL) {
+            throw std::runtime_error("Could not open " + path + "!");
+        }
+
+        length = SDL_RWsize(file);
+        Uint8* buffer = static_cast<Uint8*>(SDL_malloc(length > 0 ? length : 1));
+        if (buffer == NULL || SDL_RWread(file, buffer, 1, length) != length) {
+            SDL_free(buffer);
+            SDL_RWclose(file);
+            throw std::runtime_error("Could not read " + path + "!");
+        }
+
+        SDL_RWclose(file);
+        bytes = buffer;
+#endif
+    }
+
+    MappedFile::~MappedFile() {
+#ifdef SDL_TRIGGER_HAS_MMAP
+        if (isMapped) {
+            munmap(const_cast<Uint8*>(bytes), length);
+        }
+#else
+        SDL_free(const_cast<Uint8*>(bytes));
+#endif
+    }
+
+    const Uint8* MappedFile::data() const {
+        return bytes;
+    }
+
+    size_t MappedFile::size() const {
+        return length;
+    }
+
+    Recorder::Recorder(const std::string& path, Context& context) : context(context), file{NULL}, buffer{}, recorded{0}, isRecording{false} {
+        file = SDL_RWFromFile(path.c_str(), "wb");
+        if (file == NULL) {
+            throw std::runtime_error("Could not create " + path + "!");
+        }
+
+        RecordingHeader header;
+        std::memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+        header.version = SDL_SwapLE32(RECORDING_VERSION);
+        header.recordSize = SDL_SwapLE32(static_cast<Uint32>(sizeof(RecordedEvent)));
+
+        if (SDL_RWwrite(file, &header, sizeof(header), 1) != 1) {
+            SDL_RWclose(file);
+            throw std::runtime_error("Could not write " + path + "!");
+        }
+
+        buffer.reserve(BUFFERED_EVENTS);
+    }
+
+    Recorder::~Recorder() {
+        stop();
+        SDL_RWclose(file);
+    }
+
+    void Recorder::start() {
+        context.setEventHook(&Recorder::record, this);
+        isRecording = true;
+    }
+
+    void Recorder::stop() {
+        if (isRecording) {
+            context.setEventHook(NULL);
+            isRecording = false;
+        }
+
+        flush();
+    }
+
+    void Recorder::flush() {
+        if (!buffer.empty()) {
+            if (SDL_RWwrite(file, buffer.data(), sizeof(RecordedEvent), buffer.size()) != buffer.size()) {
+                throw std::runtime_error("Could not write recorded events!");
+            }
+            buffer.clear();
+        }
+    }
+
+    Uint64 Recorder::recordedEvents() const {
+        return recorded;
+    }
+
+    void Recorder::record(const SDL_Event& e, void* userdata) {
+        Recorder* recorder = static_cast<Recorder*>(userdata);
+
+        recorder->buffer.push_back(RecordedEvent::of(e));
+        recorder->recorded++;
+
+        if (recorder->buffer.size() == BUFFERED_EVENTS) {
+            recorder->flush();
+        }
+    }
+
+    Replayer::Replayer(const std::string& path, Context& context) : context(context), file{path}, events{NULL}, count{0}, fired{} {
+        RecordingHeader header;
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error(path + " is not a recording!");
+        }
+
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) != 0 ||
+            SDL_SwapLE32(header.version) != RECORDING_VERSION ||
+            SDL_SwapLE32(header.recordSize) != sizeof(RecordedEvent)) {
+            throw std::runtime_error(path + " is not a recording of this version!");
+        }
+
+        // an unfinished last record is ignored
+        events = reinterpret_cast<const RecordedEvent*>(file.data() + sizeof(header));
+        count = (file.size() - sizeof(header)) / sizeof(RecordedEvent);
+    }
+
+    size_t Replayer::eventCount() const {
+        return count;
+    }
+
+    SDL_Event Replayer::eventAt(size_t index) const {
+        return events[index].toEvent();
+    }
+
+    Uint64 Replayer::run(Speed speed) {
+        // deferred mode tells which triggers fired, their callbacks are
+        // called right after each event, like processEvent would, and
+        // dispatched by the context, so the callbacks see each other
+        // unbinding triggers and destroying groups
+        const bool wasDeferred = context.isDeferred();
+        context.setDeferred(true);
+
+        // the timers follow the recorded timestamps from the first event on
+        context.timers.reset();
+
+        Uint64 called = 0;
+
+        const Uint32 startTicks = SDL_GetTicks();
+        const Uint32 firstTimestamp = count > 0 ? SDL_SwapLE32(events[0].timestamp) : 0;
+
+        for (size_t i = 0; i < count; i++) {
+            const SDL_Event e = events[i].toEvent();
+
+            if (speed == REAL_TIME) {
+                const Uint32 due = startTicks + (e.key.timestamp - firstTimestamp);
+                const Uint32 now = SDL_GetTicks();
+                if (static_cast<Sint32>(due - now) > 0) {
+                    SDL_Delay(due - now);
+                }
+            }
+
+            context.processEvent(e);
+            called += context.dispatchPending(&Replayer::countFire, this);
+        }
+
+        context.setDeferred(wasDeferred);
+
+        return called;
+    }
+
+    void Replayer::countFire(const PendingCallback& callback, void* userdata) {
+        Replayer* replayer = static_cast<Replayer*>(userdata);
+
+        auto& counts = replayer->fired[callback.group];
+        if (counts.size() <= callback.trigger) {
+            counts.resize(callback.trigger + 1, 0);
+        }
+        counts[callback.trigger]++;
+    }
+
+    std::vector<Replayer::FireCount> Replayer::fireCounts() const {
+        std::lock_guard<std::recursive_mutex> lock(context.groupsMutex);
+
+        std::vector<FireCount> result;
+        for (const auto group : context.groups) {
+            // NULL if destroyed by a callback of the current event, never in fired
+            const auto found = fired.find(group);
+            if (found == fired.end()) {
+                continue;
+            }
+
+            for (size_t trigger = 0; trigger < found->second.size(); trigger++) {
+                if (found->second[trigger] > 0) {
+                    result.push_back({group, trigger, found->second[trigger]});
+                }
+            }
+        }
+
+        return result;
+    }
+
+} // namespace Trigger
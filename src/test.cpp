@@ -0,0 +1,834 @@
+#include "sdl_trigger.h"
+#include "sdl_trigger_keymap.h"
+#include "sdl_trigger_static.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+// the matching semantics written down as plainly as possible, and a fuzzer
+// feeding random bindings of every kind, keystrokes, timer ticks and group
+// operations to both the engine and this reference model, inline and in
+// deferred mode, the callbacks must be called in the same order
+
+using Kind = Trigger::Trigger::Kind;
+
+static const SDL_Keycode ALPHABET[] = {'a', 'c', 'k', 'q', 'r', SDLK_LCTRL, SDLK_RCTRL, SDLK_LSHIFT};
+static const Uint16 ALPHABET_MODIFIERS[] = {0, 0, 0, 0, 0, KMOD_LCTRL, KMOD_RCTRL, KMOD_LSHIFT};
+static const size_t ALPHABET_SIZE = sizeof(ALPHABET) / sizeof(ALPHABET[0]);
+
+static SDL_Event keyEvent(Uint32 type, SDL_Keycode key, Uint32 timestamp) {
+    SDL_Event e;
+    std::memset(&e, 0, sizeof(e));
+    e.type = type;
+    e.key.timestamp = timestamp;
+    e.key.state = type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED;
+    e.key.keysym.sym = key;
+    e.key.keysym.scancode = SDL_GetScancodeFromKey(key);
+    return e;
+}
+
+// the held keys of the alphabet and the non-repeated keypresses so far
+struct ReferenceKeyboard {
+    bool isDown[ALPHABET_SIZE];
+    Uint32 presses;
+
+    bool isKeyDown(SDL_Keycode key) const {
+        for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+            if (ALPHABET[i] == key) {
+                return isDown[i];
+            }
+        }
+        return false;
+    }
+
+    Trigger::Keycodes heldChord() const {
+        Trigger::Keycodes held;
+        for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+            if (isDown[i]) {
+                held.push_back(ALPHABET[i]);
+            }
+        }
+        std::sort(held.begin(), held.end());
+        return held;
+    }
+};
+
+// a keypress marks its key in the combinations holding it and resets every
+// other one, a combination with all of its keys marked and still held is
+// fulfilled, then it fires depending on its kind
+struct ReferenceTrigger {
+    Kind kind;
+    Trigger::Keycodes keys;
+    std::vector<bool> isMarked;
+    Uint16 modifiers; // of MODIFIED ones, they have a single key
+    Uint32 interval;  // of HOLD and REPEAT ones
+    std::vector<Trigger::Keycodes> steps; // of SEQUENCE ones, as sorted chords, they have no keys
+    Uint32 id;          // passed to the callback, slots are reused
+    Uint32 boundAt;     // sequences ending with the same steps fire in the order they were bound in
+    Uint32 timerSerial; // its timers scheduled before it was fulfilled again, rebound or unbound are stale
+    bool isBound;
+
+    void forget() {
+        isMarked.assign(keys.size(), false);
+    }
+
+    bool hasKey(SDL_Keycode key) const {
+        return std::find(keys.begin(), keys.end(), key) != keys.end();
+    }
+
+    bool isFulfilled(const ReferenceKeyboard& keyboard) const {
+        for (size_t slot = 0; slot < keys.size(); slot++) {
+            if (!isMarked[slot] || !keyboard.isKeyDown(keys[slot])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool matchesModifiers(Uint16 mod) const {
+        static const Uint16 SIDES[][2] = {
+            {KMOD_LSHIFT, KMOD_RSHIFT}, {KMOD_LCTRL, KMOD_RCTRL}, {KMOD_LALT, KMOD_RALT}, {KMOD_LGUI, KMOD_RGUI}
+        };
+
+        for (const auto& sides : SIDES) {
+            const bool isLeftHeld = (mod & sides[0]) != 0;
+            const bool isRightHeld = (mod & sides[1]) != 0;
+            const bool isLeftRequired = (modifiers & sides[0]) != 0;
+            const bool isRightRequired = (modifiers & sides[1]) != 0;
+
+            if (isLeftRequired && isRightRequired) {
+                if (!isLeftHeld && !isRightHeld) {
+                    return false;
+                }
+            } else if (isLeftHeld != isLeftRequired || isRightHeld != isRightRequired) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+static ReferenceTrigger referenceTrigger(Kind kind, const Trigger::Keycodes& keys, Uint32 id) {
+    ReferenceTrigger trigger;
+    trigger.kind = kind;
+    trigger.keys = keys;
+    trigger.isMarked.assign(keys.size(), false);
+    trigger.modifiers = 0;
+    trigger.interval = 0;
+    trigger.id = id;
+    trigger.boundAt = 0;
+    trigger.timerSerial = 0;
+    trigger.isBound = true;
+    return trigger;
+}
+
+// a hold or repeat trigger fulfilled by a keypress, it fires at the
+// deadline if no key was pressed and none of its keys released since
+struct ReferenceTimer {
+    Uint32 group;
+    size_t slot;
+    Uint32 id;
+    Uint32 serial;
+    Uint32 press;
+    Uint32 deadline;
+};
+
+struct ReferenceGroup {
+    std::vector<ReferenceTrigger> triggers; // by slot, the callbacks of a keypress are called in slot order
+    std::vector<size_t> freeSlots;          // the last unbound one is reused first
+    bool isEnabled;
+    int priority;
+    Uint32 prioritySince; // the earlier one goes first among the same priorities
+    bool isConsuming;
+
+    // every sequence bound so far, their steps stay steps after they are
+    // unbound, the current one is the steps taken since the last reset
+    std::vector<std::vector<Trigger::Keycodes>> sequences;
+    std::vector<Trigger::Keycodes> sequence;
+    Uint32 sequenceStepTime;
+    Uint32 sequenceTimeout;
+
+    // the bindings of a reloaded keymap, taken over before its next keypress
+    std::vector<ReferenceTrigger> reloaded;
+    bool hasReloaded;
+
+    ReferenceGroup() : isEnabled{true}, priority{0}, prioritySince{0}, isConsuming{false}, sequenceStepTime{0},
+                       sequenceTimeout{Trigger::Group::DEFAULT_SEQUENCE_TIMEOUT}, hasReloaded{false} {
+        //
+    }
+
+    // a keypress of another group consumed
+    void forgetPresses() {
+        for (auto& trigger : triggers) {
+            trigger.forget();
+        }
+    }
+
+    void reset() {
+        forgetPresses();
+        sequence.clear();
+    }
+
+    // appends the fired triggers, schedules the timers and tells whether the keypress is consumed
+    bool processPress(const SDL_Event& e, Uint32 group, const ReferenceKeyboard& keyboard, std::vector<Uint32>& fires, std::vector<ReferenceTimer>& timers) {
+        const SDL_Keycode key = e.key.keysym.sym;
+        bool hasFired = false;
+
+        if (hasReloaded) {
+            triggers.swap(reloaded);
+            reloaded.clear();
+            hasReloaded = false;
+        }
+
+        for (auto& trigger : triggers) {
+            const bool hasKey = trigger.hasKey(key);
+            for (size_t slot = 0; slot < trigger.keys.size(); slot++) {
+                trigger.isMarked[slot] = hasKey && (trigger.isMarked[slot] || trigger.keys[slot] == key);
+            }
+        }
+
+        for (size_t slot = 0; slot < triggers.size(); slot++) {
+            auto& trigger = triggers[slot];
+            if (!trigger.isBound || trigger.kind == Kind::SEQUENCE || !trigger.isFulfilled(keyboard)) {
+                continue;
+            }
+
+            if (trigger.kind == Kind::HOLD || trigger.kind == Kind::REPEAT) {
+                trigger.timerSerial++;
+                timers.push_back({group, slot, trigger.id, trigger.timerSerial, keyboard.presses, e.key.timestamp + trigger.interval});
+            }
+
+            if (trigger.kind == Kind::PRESS || trigger.kind == Kind::REPEAT ||
+                (trigger.kind == Kind::MODIFIED && trigger.matchesModifiers(e.key.keysym.mod))) {
+                fires.push_back(group << 16 | trigger.id);
+                hasFired = true;
+            }
+        }
+
+        if (!sequences.empty() && advanceSequences(e.key.timestamp, group, keyboard, fires)) {
+            hasFired = true;
+        }
+
+        return isConsuming && hasFired;
+    }
+
+    // a release fires the release triggers of the key, if their combination
+    // is fulfilled, the released key is still held in the keyboard given
+    bool processRelease(SDL_Keycode key, Uint32 group, const ReferenceKeyboard& keyboard, std::vector<Uint32>& fires) {
+        bool hasFired = false;
+
+        for (auto& trigger : triggers) {
+            if (trigger.isBound && trigger.kind == Kind::RELEASE && trigger.hasKey(key) && trigger.isFulfilled(keyboard)) {
+                // once, until the combination is fulfilled again
+                trigger.forget();
+                fires.push_back(group << 16 | trigger.id);
+                hasFired = true;
+            }
+        }
+
+        return isConsuming && hasFired;
+    }
+
+    // the held keys are the next step if some sequence goes on with them,
+    // or else the first step of one, the sequences of exactly the steps
+    // taken fire
+    bool advanceSequences(Uint32 now, Uint32 group, const ReferenceKeyboard& keyboard, std::vector<Uint32>& fires) {
+        if (!sequence.empty() && now - sequenceStepTime > sequenceTimeout) {
+            sequence.clear();
+        }
+
+        const Trigger::Keycodes held = keyboard.heldChord();
+        std::vector<Trigger::Keycodes> steps = sequence;
+        steps.push_back(held);
+        if (!hasSequenceAfter(steps, 0) && !sequence.empty()) {
+            steps.assign(1, held);
+        }
+
+        if (!hasSequenceAfter(steps, 0)) {
+            // unless the held keys may still become the next step (eg. Ctrl pressed again)
+            if (!sequence.empty() && !canStepWith(held)) {
+                sequence.clear();
+            }
+            return false;
+        }
+
+        std::vector<const ReferenceTrigger*> ended;
+        for (const auto& trigger : triggers) {
+            if (trigger.isBound && trigger.kind == Kind::SEQUENCE && trigger.steps == steps) {
+                ended.push_back(&trigger);
+            }
+        }
+        std::sort(ended.begin(), ended.end(), [](const ReferenceTrigger* a, const ReferenceTrigger* b) {
+            return a->boundAt < b->boundAt;
+        });
+
+        for (const auto trigger : ended) {
+            fires.push_back(group << 16 | trigger->id);
+        }
+
+        sequence = hasSequenceAfter(steps, 1) ? steps : std::vector<Trigger::Keycodes>();
+        sequenceStepTime = now;
+
+        return !ended.empty();
+    }
+
+    // a sequence starting with the steps and at least that many more
+    bool hasSequenceAfter(const std::vector<Trigger::Keycodes>& steps, size_t more) const {
+        for (const auto& bound : sequences) {
+            if (bound.size() >= steps.size() + more && std::equal(steps.begin(), steps.end(), bound.begin())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool canStepWith(const Trigger::Keycodes& held) const {
+        for (const auto& bound : sequences) {
+            if (bound.size() > sequence.size() && std::equal(sequence.begin(), sequence.end(), bound.begin()) &&
+                std::includes(bound[sequence.size()].begin(), bound[sequence.size()].end(), held.begin(), held.end())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the lowest bound slot of exactly these keys
+    size_t find(const Trigger::Keycodes& keys) const {
+        for (size_t slot = 0; slot < triggers.size(); slot++) {
+            if (triggers[slot].isBound && triggers[slot].keys == keys) {
+                return slot;
+            }
+        }
+        return triggers.size();
+    }
+};
+
+// the timers due at this millisecond, a repeating one is due again an interval later
+static void expireReference(std::vector<ReferenceGroup>& references, std::vector<ReferenceTimer>& timers, Uint32 now,
+                            const ReferenceKeyboard& keyboard, std::vector<Uint32>& fires) {
+    for (size_t i = 0; i < timers.size();) {
+        if (timers[i].deadline != now) {
+            i++;
+            continue;
+        }
+
+        const ReferenceTimer timer = timers[i];
+        timers.erase(timers.begin() + i);
+
+        const auto& group = references[timer.group];
+        const auto& trigger = group.triggers[timer.slot];
+        if (!group.isEnabled || !trigger.isBound || trigger.id != timer.id || trigger.timerSerial != timer.serial ||
+            keyboard.presses != timer.press || !trigger.isFulfilled(keyboard)) {
+            continue;
+        }
+
+        fires.push_back(timer.group << 16 | timer.id);
+        if (trigger.kind == Kind::REPEAT) {
+            ReferenceTimer next = timer;
+            next.deadline += trigger.interval;
+            timers.push_back(next);
+        }
+    }
+}
+
+// the groups of the fuzzer, the dynamic ones first
+static const Uint32 DYNAMIC_GROUPS = 3;
+static const Uint32 STATIC_GROUP = DYNAMIC_GROUPS;
+static const Uint32 KEYMAP_GROUP = DYNAMIC_GROUPS + 1;
+static const Uint32 GROUP_COUNT = DYNAMIC_GROUPS + 2;
+
+static std::vector<Uint32>* staticFires = NULL;
+
+template <Uint32 Id>
+static void fireStatic() {
+    staticFires->push_back(STATIC_GROUP << 16 | Id);
+}
+
+template <Uint32 Id, SDL_Keycode... Keys>
+using StaticBinding = Trigger::Binding<fireStatic<Id>, Keys...>;
+
+using StaticTable = Trigger::StaticGroup<
+    StaticBinding<0, 'a'>, StaticBinding<1, 'c', 'k'>, StaticBinding<2, SDLK_LCTRL, 'q'>, StaticBinding<3, 'k', 'k'>,
+    StaticBinding<4, 'r', 'a', 'c'>, StaticBinding<5>, StaticBinding<6, SDLK_LSHIFT, SDLK_RCTRL>
+>;
+
+static const std::vector<Trigger::Keycodes> STATIC_KEYS = {
+    {'a'}, {'c', 'k'}, {SDLK_LCTRL, 'q'}, {'k', 'k'}, {'r', 'a', 'c'}, {}, {SDLK_LSHIFT, SDLK_RCTRL}
+};
+
+static const char* const KEYMAP_TEXT = "test_keymap.txt";
+static const char* const KEYMAP_PATH = "test_keymap.bin";
+
+// the operations every kind of group has
+template <typename G>
+static void changeGroup(G& group, ReferenceGroup& reference, Uint32 operation, std::mt19937& random, Uint32& priorityChanges) {
+    switch (operation) {
+        case 0:
+            group.toggle();
+            if (reference.isEnabled) {
+                reference.reset();
+            }
+            reference.isEnabled = !reference.isEnabled;
+            break;
+        case 1:
+            group.disable();
+            reference.reset();
+            reference.isEnabled = false;
+            break;
+        case 2:
+            group.reset();
+            reference.reset();
+            break;
+        case 3:
+            reference.priority = random() % 3;
+            reference.prioritySince = priorityChanges++;
+            group.setPriority(reference.priority);
+            break;
+        default:
+            reference.isConsuming = random() % 4 == 0;
+            group.setConsuming(reference.isConsuming);
+            break;
+    }
+}
+
+static bool fuzzReference(size_t seeds, bool isDeferred) {
+    static const Uint16 MODIFIERS[] = {KMOD_NONE, KMOD_CTRL, KMOD_LCTRL, KMOD_RCTRL, KMOD_SHIFT, KMOD_LSHIFT, KMOD_CTRL | KMOD_SHIFT, KMOD_CTRL | KMOD_CAPS};
+    static const Kind KINDS[] = {Kind::PRESS, Kind::PRESS, Kind::PRESS, Kind::MODIFIED, Kind::SEQUENCE, Kind::SEQUENCE, Kind::HOLD, Kind::REPEAT, Kind::RELEASE, Kind::RELEASE};
+    static const size_t STEPS_PER_SEED = 400;
+
+    const char* name = isDeferred ? "reference_fuzz_deferred" : "reference_fuzz";
+
+    Trigger::setDeferred(isDeferred);
+
+    std::vector<Uint32> expected, fires;
+    size_t events = 0;
+    size_t callbacks = 0;
+    staticFires = &fires;
+
+    for (size_t seed = 0; seed < seeds; seed++) {
+        std::mt19937 random(seed);
+        Uint32 priorityChanges = 0;
+
+        // declared before the groups, they use them until they are destroyed
+        Trigger::CallbackRegistry registry;
+
+        std::vector<ReferenceGroup> references(GROUP_COUNT);
+        std::vector<std::unique_ptr<Trigger::Group>> groups;
+        std::vector<std::vector<Trigger::Handle>> handles(DYNAMIC_GROUPS); // by slot
+        std::unique_ptr<StaticTable> table;
+        std::unique_ptr<Trigger::KeymapGroup> keymap;
+        std::vector<ReferenceTimer> timers;
+        Uint32 nextId = 0;
+
+        // duplicated keys and, rarely, empty combinations included
+        const auto randomKeys = [&random](Kind kind) {
+            size_t count = random() % 20 == 0 ? 0 : random() % 4;
+            if (kind == Kind::MODIFIED) {
+                count = 1;
+            } else if (kind != Kind::PRESS) {
+                count = 1 + random() % 3;
+            }
+
+            Trigger::Keycodes keys(count);
+            for (auto& key : keys) {
+                key = ALPHABET[random() % ALPHABET_SIZE];
+            }
+            return keys;
+        };
+
+        const auto bind = [&](Uint32 g) {
+            const Kind kind = KINDS[random() % (sizeof(KINDS) / sizeof(KINDS[0]))];
+            const Uint32 id = nextId++;
+            ReferenceTrigger trigger = referenceTrigger(kind, kind == Kind::SEQUENCE ? Trigger::Keycodes() : randomKeys(kind), id);
+            trigger.boundAt = id;
+
+            const auto callback = [&fires, g, id]() {
+                fires.push_back(g << 16 | id);
+            };
+
+            Trigger::Handle handle;
+            switch (kind) {
+                case Kind::MODIFIED:
+                    trigger.modifiers = MODIFIERS[random() % (sizeof(MODIFIERS) / sizeof(MODIFIERS[0]))];
+                    handle = groups[g]->onModified(trigger.modifiers, trigger.keys[0], callback);
+                    break;
+                case Kind::SEQUENCE: {
+                    std::vector<Trigger::Keycodes> steps(1 + random() % 3);
+                    for (auto& step : steps) {
+                        step.resize(random() % 3 == 0 ? 2 : 1);
+                        for (auto& key : step) {
+                            key = ALPHABET[random() % ALPHABET_SIZE];
+                        }
+                    }
+                    handle = groups[g]->onSequence(steps, callback);
+
+                    // a step is the set of its keys
+                    for (auto& step : steps) {
+                        std::sort(step.begin(), step.end());
+                        step.erase(std::unique(step.begin(), step.end()), step.end());
+                    }
+                    trigger.steps = steps;
+                    references[g].sequences.push_back(steps);
+                    break;
+                }
+                case Kind::HOLD:
+                    trigger.interval = 1 + random() % 40;
+                    handle = groups[g]->onHold(trigger.keys, trigger.interval, callback);
+                    break;
+                case Kind::REPEAT:
+                    trigger.interval = 1 + random() % 20;
+                    handle = groups[g]->onRepeat(trigger.keys, trigger.interval, callback);
+                    break;
+                case Kind::RELEASE:
+                    handle = groups[g]->onRelease(trigger.keys, callback);
+                    break;
+                default:
+                    handle = groups[g]->on(trigger.keys, callback);
+                    break;
+            }
+
+            auto& reference = references[g];
+            size_t slot = reference.triggers.size();
+            if (!reference.freeSlots.empty()) {
+                slot = reference.freeSlots.back();
+                reference.freeSlots.pop_back();
+            } else {
+                reference.triggers.emplace_back();
+                handles[g].emplace_back();
+            }
+            reference.triggers[slot] = trigger;
+            handles[g][slot] = handle;
+
+            return handle.index == slot;
+        };
+
+        // a random keymap, with its callbacks registered under new names,
+        // the compiled file is unlinked right away, the mapping keeps it,
+        // so the next one is never written over a mapped one
+        const auto compileRandomKeymap = [&]() {
+            std::vector<ReferenceTrigger> triggers;
+
+            FILE* text = fopen(KEYMAP_TEXT, "w");
+            if (text == NULL) {
+                throw std::runtime_error(std::string("Could not open ") + KEYMAP_TEXT + "!");
+            }
+            fprintf(text, "# seed %zu\n", seed);
+
+            const size_t bindingCount = 1 + random() % 10;
+            for (size_t binding = 0; binding < bindingCount; binding++) {
+                const Uint32 id = nextId++;
+                triggers.push_back(referenceTrigger(Kind::PRESS, randomKeys(Kind::HOLD), id));
+
+                const std::string callback = "fire" + std::to_string(id);
+                registry.add(callback, [&fires, id]() {
+                    fires.push_back(KEYMAP_GROUP << 16 | id);
+                });
+
+                for (size_t slot = 0; slot < triggers.back().keys.size(); slot++) {
+                    fprintf(text, "%s0x%x", slot > 0 ? " + " : "", static_cast<unsigned>(triggers.back().keys[slot]));
+                }
+                fprintf(text, " = %s\n", callback.c_str());
+            }
+            fclose(text);
+
+            Trigger::compileKeymap(KEYMAP_TEXT, KEYMAP_PATH);
+            return triggers;
+        };
+
+        for (Uint32 g = 0; g < GROUP_COUNT; g++) {
+            auto& reference = references[g];
+            reference.priority = random() % 3;
+            reference.prioritySince = priorityChanges++;
+            reference.isConsuming = random() % 4 == 0;
+
+            if (g == STATIC_GROUP) {
+                table.reset(new StaticTable());
+                table->setPriority(reference.priority);
+                table->setConsuming(reference.isConsuming);
+
+                for (Uint32 id = 0; id < STATIC_KEYS.size(); id++) {
+                    reference.triggers.push_back(referenceTrigger(Kind::PRESS, STATIC_KEYS[id], id));
+                }
+                continue;
+            }
+
+            if (g == KEYMAP_GROUP) {
+                keymap.reset(new Trigger::KeymapGroup(registry));
+                keymap->setPriority(reference.priority);
+                keymap->setConsuming(reference.isConsuming);
+
+                reference.triggers = compileRandomKeymap();
+                keymap->load(KEYMAP_PATH);
+                std::remove(KEYMAP_PATH);
+                continue;
+            }
+
+            // the layout is fixed, so scancode groups have to match the same,
+            // and so do the evaluations
+            groups.emplace_back(new Trigger::Group(random() % 2 == 0 ? Trigger::Group::BY_KEYCODE : Trigger::Group::BY_SCANCODE));
+            groups[g]->setEvaluation(static_cast<Trigger::Group::Evaluation>((seed + g) % 3));
+            groups[g]->setPriority(reference.priority);
+            groups[g]->setConsuming(reference.isConsuming);
+            reference.sequenceTimeout = 5 + random() % 100;
+            groups[g]->setSequenceTimeout(reference.sequenceTimeout);
+
+            const size_t triggerCount = random() % 12;
+            for (Uint32 index = 0; index < triggerCount; index++) {
+                bind(g);
+            }
+        }
+
+        Trigger::keyboard.reset();
+        Trigger::timers.reset();
+        ReferenceKeyboard keyboard = {};
+        Uint32 timestamp = 0;
+
+        for (size_t step = 0; step < STEPS_PER_SEED; step++) {
+            const Uint32 roll = random() % 100;
+
+            if (roll < 8) {
+                const Uint32 g = random() % GROUP_COUNT;
+                auto& reference = references[g];
+                const size_t slot = reference.triggers.empty() ? 0 : random() % reference.triggers.size();
+                const Uint32 operation = random() % 10;
+                bool isConsistent = true;
+
+                if (g == STATIC_GROUP) {
+                    changeGroup(*table, reference, operation % 5, random, priorityChanges);
+                    continue;
+                }
+
+                if (g == KEYMAP_GROUP) {
+                    if (operation < 5) {
+                        changeGroup(*keymap, reference, operation, random, priorityChanges);
+                    } else if (operation < 7) {
+                        // an earlier reload is dropped either way
+                        reference.reloaded = compileRandomKeymap();
+                        reference.hasReloaded = true;
+                        keymap->reload(KEYMAP_PATH);
+                    } else {
+                        reference.triggers = compileRandomKeymap();
+                        reference.reloaded.clear();
+                        reference.hasReloaded = false;
+                        keymap->load(KEYMAP_PATH);
+                    }
+                    std::remove(KEYMAP_PATH);
+                    continue;
+                }
+
+                switch (operation) {
+                    case 5:
+                        isConsistent = bind(g);
+                        break;
+                    case 6:
+                        // unbinding twice does nothing
+                        if (slot < reference.triggers.size()) {
+                            isConsistent = groups[g]->off(handles[g][slot]) == reference.triggers[slot].isBound;
+                            if (reference.triggers[slot].isBound) {
+                                reference.triggers[slot].isBound = false;
+                                reference.freeSlots.push_back(slot);
+                            }
+                            isConsistent = isConsistent && !groups[g]->isBound(handles[g][slot]);
+                        }
+                        break;
+                    case 7:
+                        groups[g]->setEvaluation(static_cast<Trigger::Group::Evaluation>(random() % 3));
+                        break;
+                    case 8:
+                        reference.sequenceTimeout = 5 + random() % 100;
+                        groups[g]->setSequenceTimeout(reference.sequenceTimeout);
+                        break;
+                    case 9:
+                        // its keypresses and its timers are forgotten
+                        if (slot < reference.triggers.size() && reference.triggers[slot].isBound && reference.triggers[slot].kind != Kind::SEQUENCE) {
+                            auto& trigger = reference.triggers[slot];
+
+                            // keys its kind does not take are rejected, it keeps the old ones
+                            if (trigger.kind != Kind::PRESS) {
+                                const Trigger::Keycodes rejected = trigger.kind == Kind::MODIFIED ? Trigger::Keycodes{ALPHABET[0], ALPHABET[1]} : Trigger::Keycodes();
+                                bool isRejected = false;
+                                try {
+                                    groups[g]->rebind(handles[g][slot], rejected);
+                                } catch (const std::runtime_error&) {
+                                    isRejected = true;
+                                }
+                                isConsistent = isRejected && groups[g]->keyCount(handles[g][slot]) == trigger.keys.size();
+                            }
+
+                            trigger.keys = randomKeys(trigger.kind);
+                            trigger.forget();
+                            trigger.timerSerial++;
+                            groups[g]->rebind(handles[g][slot], trigger.keys);
+                        }
+                        break;
+                    default:
+                        changeGroup(*groups[g], reference, operation, random, priorityChanges);
+                        break;
+                }
+
+                // the bindings are found by their keys, in the lowest slot
+                if (slot < reference.triggers.size()) {
+                    const auto& keys = reference.triggers[slot].keys;
+                    const Trigger::Handle found = groups[g]->find(keys);
+                    const size_t expectedSlot = keys.empty() ? reference.triggers.size() : reference.find(keys);
+                    isConsistent = isConsistent && (expectedSlot < reference.triggers.size() ? found.isValid() && found.index == expectedSlot : !found.isValid());
+                }
+
+                if (!isConsistent) {
+                    fprintf(stderr, "%s: seed %zu diverges at step %zu, the bindings differ!\n", name, seed, step);
+                    Trigger::setDeferred(false);
+                    return false;
+                }
+                continue;
+            }
+
+            // a pause now and then, the timers expire millisecond by
+            // millisecond, in no particular order within one
+            const Uint32 lastTick = timestamp;
+            timestamp += random() % 16 == 0 ? 50 + random() % 100 : 1 + random() % 12;
+            for (Uint32 now = lastTick + 1; now <= timestamp; now++) {
+                expected.clear();
+                expireReference(references, timers, now, keyboard, expected);
+
+                fires.clear();
+                Trigger::tick(now);
+                if (isDeferred) {
+                    Trigger::dispatchPending();
+                }
+
+                std::sort(expected.begin(), expected.end());
+                std::sort(fires.begin(), fires.end());
+                if (fires != expected) {
+                    fprintf(stderr, "%s: seed %zu diverges at step %zu, %zu timers expired at %u instead of %zu!\n",
+                            name, seed, step, fires.size(), now, expected.size());
+                    Trigger::setDeferred(false);
+                    return false;
+                }
+                callbacks += fires.size();
+            }
+
+            // mostly short chords, and every other seed types a key at a
+            // time, so the steps of sequences are held exactly and go on
+            size_t k = random() % ALPHABET_SIZE;
+            const Trigger::Keycodes held = keyboard.heldChord();
+            if (held.size() > (seed % 2 == 0 ? 0 : 1) && random() % 3 != 0) {
+                k = std::find(ALPHABET, ALPHABET + ALPHABET_SIZE, held[random() % held.size()]) - ALPHABET;
+            }
+            SDL_Event e = keyEvent(SDL_KEYDOWN, ALPHABET[k], timestamp);
+            const bool wasDown = keyboard.isDown[k];
+            if (roll < 15) {
+                e.type = SDL_MOUSEMOTION;
+            } else if (!wasDown || roll < 20) {
+                e.key.repeat = wasDown && roll >= 17 ? 1 : 0;
+                keyboard.isDown[k] = true;
+                keyboard.presses += e.key.repeat == 0 ? 1 : 0;
+            } else {
+                e.type = SDL_KEYUP;
+                e.key.state = SDL_RELEASED;
+            }
+
+            // like SDL, with the pressed modifier already held and a lock key now and then
+            e.key.keysym.mod = step % 3 == 0 ? KMOD_NUM : KMOD_NONE;
+            for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+                if (keyboard.isDown[i]) {
+                    e.key.keysym.mod |= ALPHABET_MODIFIERS[i];
+                }
+            }
+
+            // highest priority first
+            std::vector<Uint32> order(GROUP_COUNT);
+            for (Uint32 g = 0; g < GROUP_COUNT; g++) {
+                order[g] = g;
+            }
+            std::sort(order.begin(), order.end(), [&references](Uint32 a, Uint32 b) {
+                if (references[a].priority != references[b].priority) {
+                    return references[a].priority > references[b].priority;
+                }
+                return references[a].prioritySince < references[b].prioritySince;
+            });
+
+            expected.clear();
+            bool isConsumed = false;
+            for (auto g : order) {
+                auto& reference = references[g];
+                if (!reference.isEnabled) {
+                    continue;
+                }
+
+                if (e.type == SDL_KEYDOWN && e.key.repeat == 0) {
+                    if (!isConsumed) {
+                        isConsumed = reference.processPress(e, g, keyboard, expected, timers);
+                    } else {
+                        // a consumed keypress is still another key for the groups below
+                        reference.forgetPresses();
+                    }
+                } else if (e.type == SDL_KEYUP && !isConsumed) {
+                    isConsumed = reference.processRelease(e.key.keysym.sym, g, keyboard, expected);
+                }
+            }
+
+            if (e.type == SDL_KEYUP) {
+                keyboard.isDown[k] = false;
+            }
+
+            fires.clear();
+            Trigger::processEvent(e);
+            if (isDeferred) {
+                Trigger::dispatchPending();
+            }
+
+            if (fires != expected) {
+                fprintf(stderr, "%s: seed %zu diverges at step %zu, %zu callbacks instead of %zu!\n", name, seed, step, fires.size(), expected.size());
+                Trigger::setDeferred(false);
+                return false;
+            }
+            callbacks += fires.size();
+            events++;
+        }
+    }
+
+    Trigger::setDeferred(false);
+    Trigger::keyboard.reset();
+    Trigger::timers.reset();
+    std::remove(KEYMAP_TEXT);
+    staticFires = NULL;
+
+    printf("%s: %zu seeds, %zu events, %zu callbacks\n", name, seeds, events, callbacks);
+    return true;
+}
+
+int main(int argc, char const *argv[])
+{
+    size_t seeds = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+
+        if (argument == "-n" && i + 1 < argc) {
+            seeds = std::strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-n seeds]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // the scancode groups translate keycodes with the keymap of the video
+    // subsystem, no window is ever created
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return 1;
+    }
+
+    const bool isCorrect = fuzzReference(seeds, false) && fuzzReference(seeds, true);
+
+    SDL_Quit();
+
+    return isCorrect ? 0 : 1;
+}
@@ -1,6 +1,7 @@
 #include "util.h"
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 std::string currentTime() {
     std::stringstream stream;
@@ -26,6 +27,10 @@ void Surface::setFormat(SDL_PixelFormat* newFormat) {
 
 void Surface::setFont(TTF_Font* newFont) {
     font = newFont;
+
+    // the cached glyphs and texts are of the previous font
+    TextCache::clear();
+    GlyphAtlas::clear();
 }
 
 SDL_Surface* Surface::create(int width, int height) {
@@ -64,13 +69,173 @@ SDL_Surface* Surface::ofText(const char* string, SDL_Color color) {
         throw std::runtime_error("Surface::font not set!");
     }
 
-    return TTF_RenderText_Solid(font, string, color);
+    if (!GlyphAtlas::canCompose(string)) {
+        return TTF_RenderText_Solid(font, string, color);
+    }
+
+    SDL_Surface* textSurface = create(GlyphAtlas::widthOf(string, color), TTF_FontHeight(font));
+    drawText(textSurface, string, 0, 0, color);
+    return textSurface;
+}
+
+SDL_Surface* Surface::ofCachedText(const std::string& string, SDL_Color color) {
+    return TextCache::find(string, color);
+}
+
+void Surface::drawText(SDL_Surface* target, const char* string, int x, int y, SDL_Color color) {
+    if (font == nullptr) {
+        throw std::runtime_error("Surface::font not set!");
+    }
+
+    if (!GlyphAtlas::canCompose(string)) {
+        SDL_Surface* textSurface = TTF_RenderText_Solid(font, string, color);
+        SDL_Rect textRect = {x, y, 0, 0};
+        SDL_BlitSurface(textSurface, NULL, target, &textRect);
+        SDL_FreeSurface(textSurface);
+        return;
+    }
+
+    for (const char* character = string; *character != '\0'; character++) {
+        const GlyphAtlas::Glyph& glyph = GlyphAtlas::find(*character, color);
+
+        SDL_Rect source = glyph.rect;
+        SDL_Rect destination = {x, y, 0, 0};
+        SDL_BlitSurface(glyph.page, &source, target, &destination);
+
+        x += glyph.rect.w;
+    }
+}
+
+bool GlyphAtlas::canCompose(const char* string) {
+    for (const char* character = string; *character != '\0'; character++) {
+        if (*character < ' ' || *character > '~') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const GlyphAtlas::Glyph& GlyphAtlas::find(char character, SDL_Color color) {
+    const Uint32 key = Uint32(color.r) << 24 | Uint32(color.g) << 16 | Uint32(color.b) << 8 | Uint8(character);
+
+    auto found = glyphs.find(key);
+    if (found != glyphs.end()) {
+        return found->second;
+    }
+
+    // rendered alone, it is as wide as its advance and as tall as the font
+    const char string[] = {character, '\0'};
+    SDL_Surface* glyphSurface = TTF_RenderText_Solid(Surface::font, string, color);
+
+    // a glyph without pixels, like the space, may not render at all
+    int width = 0;
+    if (glyphSurface != NULL) {
+        width = glyphSurface->w;
+    } else if (TTF_GlyphMetrics(Surface::font, Uint8(character), NULL, NULL, NULL, NULL, &width) != 0) {
+        throw std::runtime_error("Could not render glyph!");
+    }
+    const int height = TTF_FontHeight(Surface::font);
+
+    if (cursorX + width > PAGE_SIZE) {
+        cursorX = 0;
+        cursorY += rowHeight;
+        rowHeight = 0;
+    }
+
+    if (pages.empty() || cursorY + height > PAGE_SIZE) {
+        pages.push_back(Surface::create(PAGE_SIZE, PAGE_SIZE));
+        cursorX = 0;
+        cursorY = 0;
+        rowHeight = 0;
+    }
+
+    Glyph glyph;
+    glyph.page = pages.back();
+    glyph.rect.x = cursorX;
+    glyph.rect.y = cursorY;
+    glyph.rect.w = width;
+    glyph.rect.h = height;
+
+    if (glyphSurface != NULL) {
+        SDL_Rect destination = glyph.rect;
+        SDL_BlitSurface(glyphSurface, NULL, glyph.page, &destination);
+        SDL_FreeSurface(glyphSurface);
+    }
+
+    cursorX += glyph.rect.w;
+    rowHeight = std::max(rowHeight, glyph.rect.h);
+
+    return glyphs.insert({key, glyph}).first->second;
+}
+
+int GlyphAtlas::widthOf(const char* string, SDL_Color color) {
+    int width = 0;
+    for (const char* character = string; *character != '\0'; character++) {
+        width += find(*character, color).rect.w;
+    }
+
+    return width;
+}
+
+void GlyphAtlas::clear() {
+    for (auto page : pages) {
+        SDL_FreeSurface(page);
+    }
+
+    pages.clear();
+    glyphs.clear();
+    cursorX = 0;
+    cursorY = 0;
+    rowHeight = 0;
+}
+
+SDL_Surface* TextCache::find(const std::string& string, SDL_Color color) {
+    // reused, so looking up a cached text allocates nothing
+    static std::string key;
+    key.assign({char(color.r), char(color.g), char(color.b)});
+    key.append(string);
+
+    auto found = index.find(key);
+    if (found != index.end()) {
+        entries.splice(entries.begin(), entries, found->second);
+        return found->second->surface;
+    }
+
+    if (entries.size() == CAPACITY) {
+        SDL_FreeSurface(entries.back().surface);
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+
+    entries.push_front({key, Surface::ofText(string.c_str(), color)});
+    index[key] = entries.begin();
+
+    return entries.front().surface;
+}
+
+void TextCache::clear() {
+    for (auto& entry : entries) {
+        SDL_FreeSurface(entry.surface);
+    }
+
+    entries.clear();
+    index.clear();
 }
 
 SDL_PixelFormat* Surface::format = NULL;
 TTF_Font* Surface::font = NULL;
 int Surface::COLOR_TRANSPARENT = 0;
 
+std::vector<SDL_Surface*> GlyphAtlas::pages;
+std::unordered_map<Uint32, GlyphAtlas::Glyph> GlyphAtlas::glyphs;
+int GlyphAtlas::cursorX = 0;
+int GlyphAtlas::cursorY = 0;
+int GlyphAtlas::rowHeight = 0;
+
+std::list<TextCache::Entry> TextCache::entries;
+std::unordered_map<std::string, std::list<TextCache::Entry>::iterator> TextCache::index;
+
 std::list<std::string> KeyPressLog::records;
 int KeyPressLog::maxRecords = 25;
 Uint32 KeyPressLog::lastAutoScroll = 0;